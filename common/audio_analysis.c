@@ -0,0 +1,256 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <stdatomic.h>
+#include <aubio/aubio.h>
+#else
+#include "aubio.h"
+#endif // __linux__
+
+#include "audio_capture.h"
+#include "audio_analysis.h"
+
+static struct {
+    unsigned int samplerate;        //!< Sample rate
+    unsigned int hop;               //!< samples per frame, effectively length of buffer
+    aubio_tempo_t* aubio_tempo;     //!< aubio tempo object, shrouded in mystery
+    fvec_t* tempo_in;               //!< input buffer for tempo, apparently array of floats in range <-1; 1>
+    fvec_t* tempo_out;              //!< tempo object writes something here, God only knows what
+    int n_users;
+} analysis;
+
+static int n_bands;
+static uint_t* band_boundaries;     //!< first FFT bin of every band, the band ends where the next one starts
+static double* fq_prefix = NULL;    //!< fq_prefix[i] is the sum of magnitudes of bins 0 .. i-1
+static double fq_statistics[FQ_STAT_LEN];
+static float last_phase;
+static audio_features_t current;    //!< features being calculated, owned by the capture thread
+
+/* Features are published through a triple buffer: the capture thread writes to `back`, then swaps it
+ * with `middle`, the reader swaps `middle` with its `front` when `middle` is marked as fresh. Neither
+ * side ever waits for the other. */
+#define FEATURES_FRESH  4
+#ifdef __linux__
+static atomic_int middle = 1;
+#define swap_middle(x)  atomic_exchange(&middle, (x))
+#define is_fresh()      (atomic_load(&middle) & FEATURES_FRESH)
+#else
+static int middle = 1;
+static int swap_middle(int x) { int old = middle; middle = x; return old; }
+#define is_fresh()      (middle & FEATURES_FRESH)
+#endif // __linux__
+static audio_features_t published[3];
+static int back = 0;
+static int front = 2;
+
+static void publish_features()
+{
+    published[back] = current;
+    back = swap_middle(back | FEATURES_FRESH) & 3;
+}
+
+int AudioAnalysis_get_features(audio_features_t* features)
+{
+    AudioCapture_poll();
+    int is_new = 0;
+    if (is_fresh())
+    {
+        front = swap_middle(front) & 3;
+        is_new = 1;
+    }
+    *features = published[front];
+    return is_new;
+}
+
+void AudioAnalysis_peek_features(audio_features_t* features)
+{
+    *features = published[front];
+}
+
+static void freq_map_init()
+{
+    uint_t length = FFT_WINDOW * analysis.hop;
+    int freq_bands[] = { 0, FQ_BASS, FQ_MID_BASS, FQ_MID_TREBLE, FQ_TREBLE };
+    n_bands = sizeof(freq_bands) / sizeof(int);
+    band_boundaries = malloc(sizeof(uint_t) * n_bands);
+    fq_prefix = malloc(sizeof(double) * (length + 1));
+
+    int iBand = n_bands - 1;
+    for (int iGrain = length - 1; iGrain >= 0; --iGrain) {
+        smpl_t freq = aubio_bintofreq((float)iGrain, (float)analysis.samplerate, 2.0f * length + 1.0f);
+        if (freq < freq_bands[iBand]) {
+            band_boundaries[iBand] = iGrain;
+            iBand--;
+        }
+    }
+    band_boundaries[0] = 0;
+}
+
+static void recalibrate_fq_boundaries(double* fq_statistics, int fqs_per_stat_bin)
+{
+    double magn_per_band = fq_statistics[FQ_STAT_LEN - 1] / n_bands;
+    double sum = 0;
+    int bin = 0;
+    int iBand = 1;
+    while (1) {
+        sum += fq_statistics[bin];
+        while (sum > magn_per_band && iBand < n_bands) {
+            double overfill = sum - magn_per_band;
+            band_boundaries[iBand++] = fqs_per_stat_bin * (bin + 1) - (int)(fqs_per_stat_bin * overfill/fq_statistics[bin]);
+            sum = overfill;
+        }
+        bin++;
+        if(iBand == n_bands)
+            break;
+    }
+}
+
+/*! Sum of magnitudes of bins from..to-1, both are clamped to the length of the FFT */
+static inline double range_sum(uint_t from, uint_t to, uint_t length)
+{
+    from = (from < length) ? from : length;
+    to = (to < length) ? to : length;
+    return fq_prefix[to] - fq_prefix[from];
+}
+
+static void analyse_bands()
+{
+    cvec_t* fftgrain = aubio_tempo_get_fftgrain(analysis.aubio_tempo);
+    uint_t length = fftgrain->length;
+    const smpl_t* norm = fftgrain->norm;
+    int fqs_per_stat_bin = (int)((length - 1) / FQ_STAT_LEN) + 1;
+
+    /* One branch-free pass over the spectrum, band and statistics sums are then just differences */
+    double running = 0;
+    float weighted_sum = 0;
+    fq_prefix[0] = 0;
+    for (uint_t iGrain = 0; iGrain < length; iGrain++) {
+        running += norm[iGrain];
+        fq_prefix[iGrain + 1] = running;
+        weighted_sum += iGrain * norm[iGrain];
+    }
+    float total_sum = (float)running;
+
+    for (int iBand = 0; iBand < n_bands; ++iBand) {
+        uint_t band_end = (iBand + 1 < n_bands) ? band_boundaries[iBand + 1] : length;
+        current.band_energy[iBand] = (float)range_sum(band_boundaries[iBand], band_end, length);
+    }
+    int n_stat_bins = (int)((length - 1) / fqs_per_stat_bin) + 1;
+    for (int bin = 0; bin < n_stat_bins; ++bin) {
+        fq_statistics[bin] += range_sum(bin * fqs_per_stat_bin, (bin + 1) * fqs_per_stat_bin, length);
+    }
+    fq_statistics[FQ_STAT_LEN - 1] += running;
+    current.spectral_centroid = (total_sum > 0) ? aubio_bintofreq(weighted_sum / total_sum, (float)analysis.samplerate, (float)(FFT_WINDOW * analysis.hop)) : 0;
+
+    if (current.hop % FQ_RECALIBRATE == 0) {
+        recalibrate_fq_boundaries(fq_statistics, fqs_per_stat_bin);
+        for(int bin = 0; bin < FQ_STAT_LEN; ++bin) {
+            fq_statistics[bin] *= 0.75; //decay of the old values
+        }
+#ifdef ANALYSISDBG
+        printf("Bands recalibrated: ");
+        for(int iBand = 0; iBand < n_bands; iBand++) printf(" %i", band_boundaries[iBand]);
+        printf("\n");
+#endif
+    }
+}
+
+static void analyse_tempo()
+{
+    current.is_onset = analysis.tempo_out->data[0] != 0;
+    current.bpm = aubio_tempo_get_bpm(analysis.aubio_tempo);
+    uint_t last_beat = aubio_tempo_get_last(analysis.aubio_tempo);
+    smpl_t beat_length = aubio_tempo_get_period(analysis.aubio_tempo);
+
+    /* we must get our current position in beat
+     * current_sample - last_beat = how many samples we are in the new beat
+     * last_beat + beat_length - current_sample = anticipated next beat  */
+    float samples_remaining = last_beat + beat_length - current.total_samples;
+
+    float phase;
+    if (samples_remaining <= 0) {
+        phase = last_phase;
+    }
+    else {
+        phase = samples_remaining / (float)beat_length; //this is 1 at the start of the beat and 0 at the end of the beat
+    }
+    if (phase > 1.0f) {
+        phase = 1.0f;
+    }
+    last_phase = phase;
+    current.beat_phase = phase;
+}
+
+/*! Called on the capture thread, analyses all complete hops waiting in the capture ring */
+static void analyse_captured()
+{
+    while (AudioCapture_read(analysis.tempo_in->data, analysis.hop))
+    {
+        current.hop++;
+        current.is_silent = aubio_silence_detection(analysis.tempo_in, aubio_tempo_get_silence(analysis.aubio_tempo));
+        if (!current.is_silent) {
+            aubio_tempo_do(analysis.aubio_tempo, analysis.tempo_in, analysis.tempo_out);
+            current.total_samples = aubio_tempo_get_total_frames(analysis.aubio_tempo);
+            analyse_bands();
+            analyse_tempo();
+        }
+        publish_features();
+    }
+}
+
+static void aubio_init()
+{
+    analysis.tempo_out = new_fvec(1);
+    analysis.tempo_in = new_fvec(analysis.hop);
+    analysis.aubio_tempo = new_aubio_tempo("default", FFT_WINDOW * analysis.hop, analysis.hop, analysis.samplerate);
+    aubio_tempo_set_threshold(analysis.aubio_tempo, ONSET_THRESHOLD);
+    fprintf(stderr, "Aubio objects initiated\n");
+}
+
+void AudioAnalysis_start(uint64_t frame_time, const char* wav_file)
+{
+    if (analysis.n_users++ > 0)
+        return;
+    /*
+     * On relationship between framerate, samplerate and samples_per_frame
+     * - samples_per_frame must be power of 2
+     * - frame rate is given
+     * - therefore only samplerate can be changed, it is samples_per_frame * framerate
+     * The samplerate above is our target, but the actual samplerate will be different
+     */
+    unsigned int framerate = (unsigned int)(1e6 / frame_time);
+    analysis.samplerate = 44100;
+    analysis.hop = analysis.samplerate / framerate;
+    if (analysis.hop < 512) analysis.hop = 512;
+    else if (analysis.hop < 1024) analysis.hop = 1024;
+    else analysis.hop = 2048;
+    analysis.samplerate = analysis.hop * framerate;
+
+    memset(&current, 0, sizeof(current));
+    memset(published, 0, sizeof(published));
+    swap_middle(1);
+    back = 0;
+    front = 2;
+    memset(fq_statistics, 0, sizeof(fq_statistics));
+    last_phase = 0;
+    AudioCapture_open(&analysis.samplerate, analysis.hop, wav_file);
+    aubio_init();
+    freq_map_init();
+    AudioCapture_start(analyse_captured);
+}
+
+void AudioAnalysis_stop()
+{
+    if (--analysis.n_users > 0)
+        return;
+    AudioCapture_stop();
+    del_aubio_tempo(analysis.aubio_tempo);
+    del_fvec(analysis.tempo_in);
+    del_fvec(analysis.tempo_out);
+    free(band_boundaries);
+    free(fq_prefix);
+}
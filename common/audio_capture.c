@@ -0,0 +1,570 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <alsa/asoundlib.h>
+#else
+#include "faketime.h"
+#include "../sound/fakealsa.h"
+#endif // __linux__
+
+#include "audio_capture.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_NEON
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AUDIO_SSE
+#endif
+
+/* The ring has exactly one producer (capture thread) and one consumer (render thread). Both indices
+ * are free running, i.e. they are never wrapped, only masked when accessing data, and each of them
+ * is written only by its owner. Without threads (on Windows) the producer is called synchronously. */
+#ifdef __linux__
+typedef atomic_uint ring_index_t;
+#define ring_load(x)        atomic_load_explicit(&(x), memory_order_acquire)
+#define ring_store(x, v)    atomic_store_explicit(&(x), (v), memory_order_release)
+#else
+typedef unsigned int ring_index_t;
+#define ring_load(x)        (x)
+#define ring_store(x, v)    ((x) = (v))
+#endif // __linux__
+
+static struct {
+    float data[AUDIO_RING_LENGTH];
+    ring_index_t head;      //!< next sample to write, owned by producer
+    ring_index_t tail;      //!< next sample to read, owned by consumer
+    ring_index_t xruns;
+} ring;
+
+static unsigned int capture_samplerate;
+static unsigned int capture_samples_per_read;
+static int16_t* read_buffer;            //!< interleaved S16_LE stereo
+static FILE* wav;                       //!< if not NULL, we are reading from file instead of hw
+static void (*on_capture)();            //!< called on the capture thread after every block
+static long wav_data_start;
+static int offline;                     //!< wav is read on demand, without thread, pacing or looping
+static int threaded;                    //!< capture thread is running
+static int finished;                    //!< offline wav has ended, or a looped one has no data
+#ifdef __linux__
+static snd_pcm_t* capture_handle;
+static pthread_t capture_thread;
+static atomic_int is_running;
+static uint64_t next_read_ns;
+#endif // __linux__
+
+#ifndef __linux__
+//fake alsa implementation
+int snd_pcm_hw_params(snd_pcm_t* pcm, snd_pcm_hw_params_t* params) {
+    (void)pcm;
+    (void)params;
+    return 0;
+}
+
+int snd_pcm_format_width(snd_pcm_format_t format) {
+    (void)format;
+    return 16;
+}
+#endif // !__linux__
+
+#ifdef __linux__
+static void hw_init()
+{
+    int err;
+    snd_pcm_hw_params_t* hw_params;
+
+    char* pcm_name;
+    //pcm_name=strdup("plughw:0,0");
+    pcm_name = strdup("default:CARD=sndrpihifiberry"); //!< Name of the card, this could be in config or command line, but I don't really care right now
+    int dir = 0;                      //!< exact_rate == samplerate --> dir = 0, exact_rate < samplerate  --> dir = -1, exact_rate > samplerate  --> dir = 1
+
+    // Now we can try opening audio device and setting all parameters
+    if ((err = snd_pcm_open(&capture_handle, pcm_name, SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+        fprintf(stderr, "cannot open audio device %s (%s)\n", pcm_name, snd_strerror(err));
+        exit(1);
+    }
+    fprintf(stderr, "PCM open\n");
+    free(pcm_name);
+
+    snd_pcm_hw_params_malloc(&hw_params);
+    fprintf(stderr, "HW params allocated\n");
+
+    if ((err = snd_pcm_hw_params_any(capture_handle, hw_params)) < 0) {
+        fprintf(stderr, "cannot initialize hardware parameter structure (%s)\n", snd_strerror(err));
+        exit(1);
+    }
+    fprintf(stderr, "HW params initialized\n");
+
+    if ((err = snd_pcm_hw_params_set_access(capture_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+        fprintf(stderr, "cannot set access type (%s)\n", snd_strerror(err));
+        exit(1);
+    }
+    fprintf(stderr, "Access set\n");
+
+    if ((err = snd_pcm_hw_params_set_format(capture_handle, hw_params, SND_PCM_FORMAT_S16_LE)) < 0) {
+        fprintf(stderr, "cannot set sample format (%s)\n", snd_strerror(err));
+        exit(1);
+    }
+    fprintf(stderr, "Format set\n");
+
+    if ((err = snd_pcm_hw_params_set_rate_near(capture_handle, hw_params, &capture_samplerate, &dir)) < 0) {
+        fprintf(stderr, "cannot set sample rate (%s)\n", snd_strerror(err));
+        exit(1);
+    }
+    fprintf(stderr, "Sample rate set to %i\n", capture_samplerate);
+    //TODO check dir and recalculate samples_per_frame if required
+
+    if ((err = snd_pcm_hw_params_set_channels(capture_handle, hw_params, AUDIO_CHANNELS)) < 0) {
+        fprintf(stderr, "cannot set channel count (%s)\n", snd_strerror(err));
+        exit(1);
+    }
+    fprintf(stderr, "Channels set\n");
+
+    if ((err = snd_pcm_hw_params(capture_handle, hw_params)) < 0) {
+        fprintf(stderr, "cannot set parameters (%s)\n", snd_strerror(err));
+        exit(1);
+    }
+    fprintf(stderr, "Parameters set to handle\n");
+
+    snd_pcm_hw_params_free(hw_params);
+    fprintf(stderr, "HW initialized\n");
+
+    if ((err = snd_pcm_prepare(capture_handle)) < 0) {
+        fprintf(stderr, "cannot prepare audio interface for use (%s)\n", snd_strerror(err));
+        exit(1);
+    }
+    fprintf(stderr, "Interface prepared\n");
+}
+
+/*!
+ * @brief Blocking read of one period from the sound card. Overruns are recovered here, on the capture
+ *        thread, the device is reopened only when ALSA cannot recover
+ * @returns number of samples read
+ */
+static int read_hw()
+{
+    snd_pcm_sframes_t n = snd_pcm_readi(capture_handle, read_buffer, capture_samples_per_read);
+    if (n > 0)
+        return (int)n;
+    ring_store(ring.xruns, ring_load(ring.xruns) + 1);
+    fprintf(stderr, "Read from audio interface failed (%s)\n", snd_strerror((int)n));
+    if (snd_pcm_recover(capture_handle, (int)n, 1) < 0)
+    {
+        snd_pcm_close(capture_handle);
+        hw_init();
+    }
+    return 0;
+}
+#endif // __linux__
+
+static void wav_init(const char* filename)
+{
+    wav = fopen(filename, "rb");
+    if (wav == NULL)
+    {
+        fprintf(stderr, "cannot open audio file %s\n", filename);
+        exit(1);
+    }
+    char id[4];
+    uint32_t size;
+    if (fread(id, 1, 4, wav) != 4 || strncmp(id, "RIFF", 4) || fread(&size, 4, 1, wav) != 1 || fread(id, 1, 4, wav) != 4 || strncmp(id, "WAVE", 4))
+    {
+        fprintf(stderr, "%s is not a wav file\n", filename);
+        exit(1);
+    }
+    while (fread(id, 1, 4, wav) == 4 && fread(&size, 4, 1, wav) == 1)
+    {
+        if (!strncmp(id, "fmt ", 4))
+        {
+            struct {
+                uint16_t format;
+                uint16_t channels;
+                uint32_t samplerate;
+                uint32_t byterate;
+                uint16_t block_align;
+                uint16_t bits;
+            } fmt;
+            if (size < sizeof(fmt) || fread(&fmt, sizeof(fmt), 1, wav) != 1)
+                break;
+            if (fmt.format != 1 || fmt.channels != AUDIO_CHANNELS || fmt.bits != 16)
+            {
+                fprintf(stderr, "Unsupported wav format in %s, only 16 bit stereo PCM is supported\n", filename);
+                exit(1);
+            }
+            capture_samplerate = fmt.samplerate;
+            fseek(wav, size - sizeof(fmt) + (size & 1), SEEK_CUR);
+        }
+        else if (!strncmp(id, "data", 4))
+        {
+            wav_data_start = ftell(wav);
+            fprintf(stderr, "Capturing from file %s, samplerate %i\n", filename, capture_samplerate);
+            return;
+        }
+        else
+        {
+            fseek(wav, size + (size & 1), SEEK_CUR);
+        }
+    }
+    fprintf(stderr, "No audio data found in %s\n", filename);
+    exit(1);
+}
+
+/*!
+ * @brief Read one block from the file, the file is looped. On Linux the reads are paced to the samplerate,
+ *        so that the rest of the pipeline sees the data arriving the same way as from the sound card.
+ *        Offline the file is played once and as fast as it is consumed. A file without data stops the capture
+ * @returns number of samples read
+ */
+static int read_wav()
+{
+    size_t n = fread(read_buffer, sizeof(int16_t) * AUDIO_CHANNELS, capture_samples_per_read, wav);
+    if (n < capture_samples_per_read)
+    {
+        if (offline)
+        {
+            finished = 1;
+            return (int)n;
+        }
+        fseek(wav, wav_data_start, SEEK_SET);
+        if (n == 0) //the last block ended exactly at the end of the file
+            n = fread(read_buffer, sizeof(int16_t) * AUDIO_CHANNELS, capture_samples_per_read, wav);
+        if (n == 0)
+        {
+            //nothing to pace the reads by, the capture thread would spin
+            fprintf(stderr, "No audio data to loop in the wav file, audio capture stopped\n");
+            finished = 1;
+#ifdef __linux__
+            atomic_store(&is_running, 0);
+#endif // __linux__
+            return 0;
+        }
+    }
+#ifdef __linux__
+    if (offline)
+        return (int)n;
+    struct timespec t;
+    if (next_read_ns == 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        next_read_ns = t.tv_sec * (long long)1e9 + t.tv_nsec;
+    }
+    next_read_ns += n * (uint64_t)1e9 / capture_samplerate;
+    t.tv_sec = next_read_ns / (long long)1e9;
+    t.tv_nsec = next_read_ns % (long long)1e9;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+#endif // __linux__
+    return (int)n;
+}
+
+/* Scalar tail of the kernel, also the whole conversion when we have no SIMD */
+static void convert_scalar(const int16_t* in, float* out, unsigned int n_samples, float* min, float* max)
+{
+    const float scale = 0.5f * INT_TO_FLOAT;
+    for (unsigned int sample = 0; sample < n_samples; ++sample)
+    {
+        float val = (float)(in[2 * sample] + in[2 * sample + 1]) * scale;
+        out[sample] = val;
+        if (val < *min) *min = val;
+        if (val > *max) *max = val;
+    }
+}
+
+void AudioCapture_convert(const int16_t* in, float* out, unsigned int n_samples, float* min, float* max)
+{
+    unsigned int sample = 0;
+#if defined(AUDIO_NEON)
+    const float32x4_t scale = vdupq_n_f32(0.5f * INT_TO_FLOAT);
+    float32x4_t vmin = vdupq_n_f32(*min);
+    float32x4_t vmax = vdupq_n_f32(*max);
+    for (; sample + 8 <= n_samples; sample += 8)
+    {
+        int16x8x2_t lr = vld2q_s16(in + 2 * sample); //deinterleaves left and right
+        float32x4_t lo = vmulq_f32(vcvtq_f32_s32(vaddl_s16(vget_low_s16(lr.val[0]), vget_low_s16(lr.val[1]))), scale);
+        float32x4_t hi = vmulq_f32(vcvtq_f32_s32(vaddl_s16(vget_high_s16(lr.val[0]), vget_high_s16(lr.val[1]))), scale);
+        vst1q_f32(out + sample, lo);
+        vst1q_f32(out + sample + 4, hi);
+        vmin = vminq_f32(vmin, vminq_f32(lo, hi));
+        vmax = vmaxq_f32(vmax, vmaxq_f32(lo, hi));
+    }
+    float lanes[4];
+    vst1q_f32(lanes, vmin);
+    for (int i = 0; i < 4; ++i) if (lanes[i] < *min) *min = lanes[i];
+    vst1q_f32(lanes, vmax);
+    for (int i = 0; i < 4; ++i) if (lanes[i] > *max) *max = lanes[i];
+#elif defined(AUDIO_SSE)
+    const __m128 scale = _mm_set1_ps(0.5f * INT_TO_FLOAT);
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128 vmin = _mm_set1_ps(*min);
+    __m128 vmax = _mm_set1_ps(*max);
+    for (; sample + 8 <= n_samples; sample += 8)
+    {
+        //madd with ones adds the neighbouring 16 bit values, i.e. left + right, into 32 bit integers
+        __m128i lo_lr = _mm_loadu_si128((const __m128i*)(in + 2 * sample));
+        __m128i hi_lr = _mm_loadu_si128((const __m128i*)(in + 2 * sample + 8));
+        __m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_madd_epi16(lo_lr, ones)), scale);
+        __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_madd_epi16(hi_lr, ones)), scale);
+        _mm_storeu_ps(out + sample, lo);
+        _mm_storeu_ps(out + sample + 4, hi);
+        vmin = _mm_min_ps(vmin, _mm_min_ps(lo, hi));
+        vmax = _mm_max_ps(vmax, _mm_max_ps(lo, hi));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, vmin);
+    for (int i = 0; i < 4; ++i) if (lanes[i] < *min) *min = lanes[i];
+    _mm_storeu_ps(lanes, vmax);
+    for (int i = 0; i < 4; ++i) if (lanes[i] > *max) *max = lanes[i];
+#endif
+    convert_scalar(in + 2 * sample, out + sample, n_samples - sample, min, max);
+}
+
+/*! Convert interleaved stereo in `read_buffer` to mono floats directly into the ring */
+static void push_samples(unsigned int n_samples)
+{
+    unsigned int head = ring.head;
+    if (n_samples > AUDIO_RING_LENGTH - (head - ring_load(ring.tail)))
+    {
+        //consumer is not keeping up, we rather drop the new data than block the capture
+        ring_store(ring.xruns, ring_load(ring.xruns) + 1);
+        return;
+    }
+    unsigned int start = head & (AUDIO_RING_LENGTH - 1);
+    unsigned int first = AUDIO_RING_LENGTH - start;
+    if (first > n_samples)
+        first = n_samples;
+    float min = 0.0f, max = 0.0f;
+    AudioCapture_convert(read_buffer, ring.data + start, first, &min, &max);
+    AudioCapture_convert(read_buffer + 2 * first, ring.data, n_samples - first, &min, &max);
+    if (min < -1.0f || max > 1.0f) {
+        fprintf(stderr, "Wrong samples, range: %f to %f\n", min, max);
+    }
+    ring_store(ring.head, head + n_samples);
+}
+
+static void capture_one_block()
+{
+    int n = 0;
+    if (wav)
+    {
+        n = read_wav();
+    }
+    else
+    {
+#ifdef __linux__
+        n = read_hw();
+#else
+        memset(read_buffer, 0, sizeof(int16_t) * AUDIO_CHANNELS * capture_samples_per_read);
+        n = capture_samples_per_read;
+#endif // __linux__
+    }
+    if (n > 0)
+        push_samples(n);
+    if (on_capture)
+        on_capture();
+}
+
+#ifdef __linux__
+static void* capture_thread_run(void* arg)
+{
+    (void)arg;
+    struct sched_param param = { .sched_priority = AUDIO_RT_PRIORITY };
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err)
+    {
+        fprintf(stderr, "Cannot set real-time priority for audio capture (%s), running with normal priority\n", strerror(err));
+    }
+    while (atomic_load(&is_running))
+    {
+        capture_one_block();
+    }
+    return NULL;
+}
+#endif // __linux__
+
+void AudioCapture_open(unsigned int* samplerate, unsigned int samples_per_read, const char* wav_file)
+{
+    capture_samplerate = *samplerate;
+    capture_samples_per_read = samples_per_read;
+    read_buffer = malloc(sizeof(int16_t) * AUDIO_CHANNELS * samples_per_read);
+    ring_store(ring.head, 0);
+    ring_store(ring.tail, 0);
+    ring_store(ring.xruns, 0);
+    finished = 0;
+    if (wav_file)
+    {
+        wav_init(wav_file);
+    }
+    else
+    {
+#ifdef __linux__
+        hw_init();
+#else
+        fprintf(stderr, "No sound card capture on this platform, use --audio_file\n");
+#endif // __linux__
+    }
+    *samplerate = capture_samplerate;
+}
+
+void AudioCapture_start(void (*on_capture_fn)())
+{
+    on_capture = on_capture_fn;
+#ifdef __linux__
+    if (offline)
+        return;
+    next_read_ns = 0;
+    atomic_store(&is_running, 1);
+    int err = pthread_create(&capture_thread, NULL, capture_thread_run, NULL);
+    if (err)
+    {
+        fprintf(stderr, "cannot start audio capture thread (%s)\n", strerror(err));
+        exit(1);
+    }
+    threaded = 1;
+    fprintf(stderr, "Audio capture thread started\n");
+#endif // __linux__
+}
+
+void AudioCapture_set_offline()
+{
+    offline = 1;
+}
+
+int AudioCapture_is_finished()
+{
+    return finished;
+}
+
+void AudioCapture_poll()
+{
+    if (!threaded && !offline && !finished && ring.head - ring.tail < capture_samples_per_read)
+        capture_one_block();
+}
+
+void AudioCapture_step()
+{
+    if (offline && !finished)
+        capture_one_block();
+}
+
+unsigned int AudioCapture_available()
+{
+    return ring_load(ring.head) - ring.tail;
+}
+
+int AudioCapture_read(float* out, unsigned int n_samples)
+{
+    unsigned int tail = ring.tail;
+    if (AudioCapture_available() < n_samples)
+        return 0;
+    unsigned int start = tail & (AUDIO_RING_LENGTH - 1);
+    unsigned int first = AUDIO_RING_LENGTH - start;
+    if (first > n_samples)
+        first = n_samples;
+    memcpy(out, ring.data + start, sizeof(float) * first);
+    memcpy(out + first, ring.data, sizeof(float) * (n_samples - first));
+    ring_store(ring.tail, tail + n_samples);
+    return 1;
+}
+
+unsigned int AudioCapture_get_xruns()
+{
+    return ring_load(ring.xruns);
+}
+
+void AudioCapture_stop()
+{
+#ifdef __linux__
+    if (threaded)
+    {
+        atomic_store(&is_running, 0);
+        pthread_join(capture_thread, NULL);
+        threaded = 0;
+    }
+    if (!wav)
+        snd_pcm_close(capture_handle);
+#endif // __linux__
+    if (wav)
+    {
+        fclose(wav);
+        wav = NULL;
+    }
+    free(read_buffer);
+}
+
+/* The conversion as it used to be done in DiscoSource, sample by sample */
+static void convert_reference(const int16_t* in, float* out, unsigned int n_samples)
+{
+    for (unsigned int sample = 0; sample < n_samples; ++sample)
+    {
+        int16_t left_val = in[2 * sample];
+        int16_t right_val = in[2 * sample + 1];
+        float avg_val = ((left_val + right_val) / 2.0f) * INT_TO_FLOAT;
+        if (avg_val * avg_val > 1.0f) {
+            fprintf(stderr, "Wrong sample: %f\n", avg_val);
+        }
+        out[sample] = avg_val;
+    }
+}
+
+static uint64_t benchmark_now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return now.tv_sec * (long long)1e9 + now.tv_nsec;
+}
+
+void AudioCapture_benchmark()
+{
+    const int n_repeats = 20000;
+    const unsigned int sizes[] = { 512, 1024, 2048 };
+    int16_t* in = malloc(sizeof(int16_t) * AUDIO_CHANNELS * 2048);
+    float* out_ref = malloc(sizeof(float) * 2048);
+    float* out = malloc(sizeof(float) * 2048);
+    for (int i = 0; i < AUDIO_CHANNELS * 2048; ++i)
+    {
+        in[i] = (int16_t)(rand() - RAND_MAX / 2);
+    }
+#if defined(AUDIO_NEON)
+    printf("PCM conversion benchmark, NEON kernel\n");
+#elif defined(AUDIO_SSE)
+    printf("PCM conversion benchmark, SSE2 kernel\n");
+#else
+    printf("PCM conversion benchmark, scalar kernel\n");
+#endif
+    for (unsigned int si = 0; si < sizeof(sizes) / sizeof(sizes[0]); ++si)
+    {
+        unsigned int n = sizes[si];
+        float min = 0.0f, max = 0.0f;
+        uint64_t t0 = benchmark_now_ns();
+        for (int r = 0; r < n_repeats; ++r)
+        {
+            convert_reference(in, out_ref, n);
+            in[r & 15] ^= 1; //so that the compiler cannot hoist the loop
+        }
+        uint64_t t1 = benchmark_now_ns();
+        for (int r = 0; r < n_repeats; ++r)
+        {
+            AudioCapture_convert(in, out, n, &min, &max);
+            in[r & 15] ^= 1;
+        }
+        uint64_t t2 = benchmark_now_ns();
+        float max_diff = 0.0f;
+        for (unsigned int i = 0; i < n; ++i)
+        {
+            float d = out[i] - out_ref[i];
+            if (d * d > max_diff) max_diff = d * d;
+        }
+        printf("samples_per_frame %4i: reference %7.1f ns, kernel %7.1f ns, speedup %.2fx, max diff^2 %g\n", n,
+            (double)(t1 - t0) / n_repeats, (double)(t2 - t1) / n_repeats, (double)(t1 - t0) / (double)(t2 - t1), max_diff);
+    }
+    free(in);
+    free(out_ref);
+    free(out);
+}
@@ -0,0 +1,177 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#ifdef __linux__
+#include "ws2811.h"
+#else
+#include "faketime.h"
+#include "fakeled.h"
+#endif // __linux__
+
+#include "audio_analysis.h"
+#include "audio_regression.h"
+
+struct trace_line {
+    long frame;
+    unsigned int total_samples;
+    float bpm;
+    int is_onset;
+    unsigned int leds_hash;
+    unsigned int first_led;
+};
+
+static FILE* trace;
+static FILE* golden;
+static int n_frames;
+static int n_mismatches;
+static uint64_t last_cpu_ns;
+static uint64_t total_cpu_ns;
+static uint64_t max_cpu_ns;
+
+static uint64_t cpu_now_ns()
+{
+    struct timespec now;
+#ifdef __linux__
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+#else
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+#endif // __linux__
+    return now.tv_sec * (long long)1e9 + now.tv_nsec;
+}
+
+/*! FNV-1a over all LEDs, so that one column of the trace tells whether the whole strip matches */
+static unsigned int hash_leds(ws2811_t* ledstrip)
+{
+    uint32_t hash = 2166136261u;
+    for (int led = 0; led < ledstrip->channel[0].count; ++led)
+    {
+        hash ^= (uint32_t)ledstrip->channel[0].leds[led];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*! @returns 1 if the next line was read from the golden trace, comments starting with # are skipped */
+static int read_golden(struct trace_line* line)
+{
+    char buf[256];
+    while (fgets(buf, sizeof(buf), golden))
+    {
+        if (buf[0] == '#')
+            continue;
+        if (sscanf(buf, "%li,%u,%f,%i,%x,%x", &line->frame, &line->total_samples, &line->bpm,
+            &line->is_onset, &line->leds_hash, &line->first_led) == 6)
+            return 1;
+        fprintf(stderr, "Malformed line in golden trace: %s", buf);
+    }
+    return 0;
+}
+
+static void report_mismatch(const struct trace_line* got, const struct trace_line* expected, const char* what)
+{
+    if (++n_mismatches > AR_MAX_REPORTED)
+        return;
+    if (expected)
+    {
+        printf("Frame %li: %s differs, got samples %u bpm %.2f onset %i leds %08x, expected samples %u bpm %.2f onset %i leds %08x\n",
+            got->frame, what, got->total_samples, got->bpm, got->is_onset, got->leds_hash,
+            expected->total_samples, expected->bpm, expected->is_onset, expected->leds_hash);
+    }
+    else
+    {
+        printf("Frame %li: %s\n", got->frame, what);
+    }
+}
+
+void AudioRegression_init(const char* trace_file, const char* golden_file)
+{
+    trace = fopen(trace_file, "w");
+    if (trace == NULL)
+    {
+        fprintf(stderr, "cannot open trace file %s\n", trace_file);
+        exit(1);
+    }
+    fprintf(trace, "#frame,total_samples,bpm,onset,leds_hash,first_led\n");
+    if (golden_file)
+    {
+        golden = fopen(golden_file, "r");
+        if (golden == NULL)
+        {
+            fprintf(stderr, "cannot open golden trace %s\n", golden_file);
+            exit(1);
+        }
+    }
+    n_frames = 0;
+    n_mismatches = 0;
+    total_cpu_ns = 0;
+    max_cpu_ns = 0;
+    last_cpu_ns = cpu_now_ns();
+}
+
+void AudioRegression_record(long frame, ws2811_t* ledstrip)
+{
+    //everything since the last frame was work, there is no sleeping on the virtual clock
+    uint64_t now = cpu_now_ns();
+    uint64_t frame_ns = now - last_cpu_ns;
+    total_cpu_ns += frame_ns;
+    if (frame_ns > max_cpu_ns)
+        max_cpu_ns = frame_ns;
+    n_frames++;
+
+    audio_features_t features;
+    AudioAnalysis_peek_features(&features);
+    struct trace_line line = {
+        .frame = frame,
+        .total_samples = features.total_samples,
+        .bpm = features.bpm,
+        .is_onset = features.is_onset,
+        .leds_hash = hash_leds(ledstrip),
+        .first_led = (unsigned int)ledstrip->channel[0].leds[0]
+    };
+    fprintf(trace, "%li,%u,%.2f,%i,%08x,%06x\n", line.frame, line.total_samples, line.bpm, line.is_onset, line.leds_hash, line.first_led);
+
+    if (golden)
+    {
+        struct trace_line expected;
+        if (!read_golden(&expected))
+        {
+            report_mismatch(&line, NULL, "golden trace is shorter");
+            fclose(golden);
+            golden = NULL;
+        }
+        else if (expected.frame != line.frame || expected.total_samples != line.total_samples)
+            report_mismatch(&line, &expected, "position");
+        else if (fabsf(expected.bpm - line.bpm) > AR_BPM_TOLERANCE)
+            report_mismatch(&line, &expected, "bpm");
+        else if (expected.is_onset != line.is_onset)
+            report_mismatch(&line, &expected, "onset");
+        else if (expected.leds_hash != line.leds_hash)
+            report_mismatch(&line, &expected, "colour");
+    }
+    //the trace itself is not part of the frame cost
+    last_cpu_ns = cpu_now_ns();
+}
+
+int AudioRegression_finish()
+{
+    if (golden)
+    {
+        struct trace_line expected;
+        if (read_golden(&expected))
+        {
+            n_mismatches++;
+            printf("Golden trace is longer, it continues with frame %li\n", expected.frame);
+        }
+        fclose(golden);
+        golden = NULL;
+    }
+    fclose(trace);
+    printf("Regression: %i frames, %i mismatches, CPU per frame %.1f us average, %.1f us max\n", n_frames, n_mismatches,
+        n_frames ? (double)total_cpu_ns / n_frames / 1e3 : 0.0, (double)max_cpu_ns / 1e3);
+    return n_mismatches;
+}
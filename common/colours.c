@@ -1,10 +1,19 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "colours.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define COLOURS_NEON
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define COLOURS_SSE
+#endif
+
 #ifndef min
 #define min(x,y)  ((x) < (y)) ? (x) : (y)
 #define max(x,y)  ((x) > (y)) ? (x) : (y)
@@ -180,6 +189,19 @@ ws2811_led_t lerp_rgb(const ws2811_led_t rgb1, const ws2811_led_t rgb2, const fl
     return hsl2rgb(&hsl_out);
 }
 
+/*!
+* \brief Precompute `lerp_hsl` from `hsl1` to `hsl2` in `steps` RGB colours, first is hsl1, last is hsl2
+*/
+void fill_hsl_ramp(ws2811_led_t* ramp, int steps, const hsl_t* hsl1, const hsl_t* hsl2)
+{
+    hsl_t hsl_out;
+    for (int i = 0; i < steps; ++i)
+    {
+        lerp_hsl(hsl1, hsl2, (float)i / (float)(steps - 1), &hsl_out);
+        ramp[i] = hsl2rgb(&hsl_out);
+    }
+}
+
 
 /*!
 * \brief Mixes two colours with two alphas, alpha1 + alpha2 <= 1, over HSL gradient
@@ -343,3 +365,44 @@ void test_rgb2hsl()
         printf("---\n");
     }
 }
+
+void lerp_rgb_buffer(const ws2811_led_t* from, const ws2811_led_t* to, int weight, ws2811_led_t* out, int n_leds)
+{
+    const uint8_t* a = (const uint8_t*)from;
+    const uint8_t* b = (const uint8_t*)to;
+    uint8_t* o = (uint8_t*)out;
+    int bytes = n_leds * (int)sizeof(ws2811_led_t);
+    int i = 0;
+    if (weight <= 0 || weight >= 256)
+    {
+        memcpy(out, (weight <= 0) ? from : to, bytes);
+        return;
+    }
+#if defined(COLOURS_NEON)
+    const uint8x8_t wa = vdup_n_u8((uint8_t)(256 - weight));
+    const uint8x8_t wb = vdup_n_u8((uint8_t)weight);
+    for (; i + 8 <= bytes; i += 8)
+    {
+        uint16x8_t acc = vmull_u8(vld1_u8(a + i), wa);
+        acc = vmlal_u8(acc, vld1_u8(b + i), wb);
+        vst1_u8(o + i, vshrn_n_u16(acc, 8));
+    }
+#elif defined(COLOURS_SSE)
+    //the sum is at most 255 * 256, it fits into 16 bits
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wa = _mm_set1_epi16((short)(256 - weight));
+    const __m128i wb = _mm_set1_epi16((short)weight);
+    for (; i + 16 <= bytes; i += 16)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa), _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa), _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+        _mm_storeu_si128((__m128i*)(o + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+#endif
+    for (; i < bytes; ++i)
+    {
+        o[i] = (uint8_t)((a[i] * (256 - weight) + b[i] * weight) >> 8);
+    }
+}
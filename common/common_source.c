@@ -13,9 +13,83 @@
 #include "colours.h"
 #include "common_source.h"
 
+static random_t default_random = { { 0x9E3779B9u, 0x243F6A88u, 0xB7E15162u, 0x7F4A7C15u } };
+static random_t* current_random = &default_random;
+
+static uint64_t splitmix64(uint64_t* x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline uint32_t rotl(uint32_t x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+void Random_seed(random_t* random, uint64_t seed)
+{
+    uint64_t a = splitmix64(&seed);
+    uint64_t b = splitmix64(&seed);
+    random->s[0] = (uint32_t)a;
+    random->s[1] = (uint32_t)(a >> 32);
+    random->s[2] = (uint32_t)b;
+    random->s[3] = (uint32_t)(b >> 32);
+    if ((random->s[0] | random->s[1] | random->s[2] | random->s[3]) == 0)
+        random->s[0] = 1; //all zeros is the only state the generator never leaves
+}
+
+/*! The top 24 bits of xoshiro128+ are good enough for a float, the low bits are the weak ones */
+#define RANDOM_STEP(s0, s1, s2, s3, result)     \
+    do {                                        \
+        result = s0 + s3;                       \
+        uint32_t t = s1 << 9;                   \
+        s2 ^= s0;                               \
+        s3 ^= s1;                               \
+        s1 ^= s2;                               \
+        s0 ^= s3;                               \
+        s2 ^= t;                                \
+        s3 = rotl(s3, 11);                      \
+    } while (0)
+
+float Random_01(random_t* random)
+{
+    uint32_t result;
+    RANDOM_STEP(random->s[0], random->s[1], random->s[2], random->s[3], result);
+    return (float)(result >> 8) * (1.0f / 16777216.0f);
+}
+
+void Random_01_n(random_t* random, float* out, int n)
+{
+    //the state stays in registers for the whole buffer
+    uint32_t s0 = random->s[0], s1 = random->s[1], s2 = random->s[2], s3 = random->s[3];
+    for (int i = 0; i < n; ++i)
+    {
+        uint32_t result;
+        RANDOM_STEP(s0, s1, s2, s3, result);
+        out[i] = (float)(result >> 8) * (1.0f / 16777216.0f);
+    }
+    random->s[0] = s0;
+    random->s[1] = s1;
+    random->s[2] = s2;
+    random->s[3] = s3;
+}
+
+void Random_set_current(random_t* random)
+{
+    current_random = random;
+}
+
 float random_01()
 {
-	return (float)rand() / (float)RAND_MAX;
+    return Random_01(current_random);
+}
+
+void random_01_n(float* out, int n)
+{
+    Random_01_n(current_random, out, n);
 }
 
 void BasicSource_build_gradient(BasicSource* basic_source, ws2811_led_t* colors, int* steps, int n_steps)
@@ -106,6 +106,7 @@ void GameSource_init(int n_leds, int time_speed, uint64_t current_time)
 
 void GameSource_destruct()
 {
+    GameObjects_destruct();
     free(canvas);
 }
 
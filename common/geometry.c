@@ -0,0 +1,561 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "geometry.h"
+
+struct geometry_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_leds;
+    uint32_t n_adjacent;
+    uint32_t n_heads;
+    uint32_t n_springs;
+};
+
+static void alloc_arrays(geometry_t* geometry, int n_leds, int n_adjacent)
+{
+    memset(geometry, 0, sizeof(*geometry));
+    geometry->n_leds = n_leds;
+    geometry->neighbor = malloc(sizeof(*geometry->neighbor) * n_leds);
+    geometry->distance = malloc(sizeof(*geometry->distance) * n_leds);
+    geometry->height = malloc(sizeof(int16_t) * n_leds);
+    geometry->ring = calloc(n_leds, sizeof(int16_t));
+    geometry->adjacent_start = malloc(sizeof(uint16_t) * (n_leds + 1));
+    geometry->adjacent = malloc(sizeof(uint16_t) * n_adjacent);
+    geometry->adjacent_distance = malloc(sizeof(uint8_t) * n_adjacent);
+    geometry->n_adjacent = n_adjacent;
+    //there can never be that many heads or springs, but I don't care about saving few bytes of memory
+    geometry->heads = malloc(sizeof(int16_t) * (n_leds / 2 + 1));
+    geometry->springs = malloc(sizeof(int16_t) * (n_leds / 2 + 1));
+    geometry->n_heads = 0;
+    geometry->n_springs = 0;
+}
+
+static void free_index(geometry_t* geometry)
+{
+    free(geometry->near_start);
+    free(geometry->near);
+    free(geometry->near_distance);
+    free(geometry->by_height);
+    free(geometry->height_start);
+    geometry->near_start = NULL;
+    geometry->near = NULL;
+    geometry->near_distance = NULL;
+    geometry->by_height = NULL;
+    geometry->height_start = NULL;
+}
+
+void Geometry_free(geometry_t* geometry)
+{
+    free(geometry->neighbor);
+    free(geometry->distance);
+    free(geometry->height);
+    free(geometry->ring);
+    free(geometry->adjacent_start);
+    free(geometry->adjacent);
+    free(geometry->adjacent_distance);
+    free(geometry->heads);
+    free(geometry->springs);
+    free_index(geometry);
+    if (geometry->fields != NULL)
+    {
+        for (int led = 0; led < geometry->n_leds; ++led)
+        {
+            if (geometry->fields[led] == NULL)
+                continue;
+            free(geometry->fields[led]->hops);
+            free(geometry->fields[led]->distance);
+            free(geometry->fields[led]);
+        }
+        free(geometry->fields);
+    }
+    memset(geometry, 0, sizeof(*geometry));
+}
+
+// These functions are only called when the geometry is compiled
+
+static int check_terminal(geometry_t* geometry, int led, dir_t flow_from, dir_t flow_to)
+{
+    int16_t (*neighbor)[N_DIRS] = geometry->neighbor;
+    return (
+        (neighbor[led][flow_from] != -1) &&  //there is something in the direction of flow
+        (neighbor[neighbor[led][flow_from]][flow_to] == led) && //I am upstream from the led in the direction of flow
+        ((neighbor[led][flow_to] == -1) || (neighbor[neighbor[led][flow_to]][flow_from] != led)) //I am either end of flow, or the led upstream from me does not flow back to me
+        );
+}
+
+static void find_heads_and_springs(geometry_t* geometry)
+{
+    geometry->n_heads = 0;
+    geometry->n_springs = 0;
+    for (int led = 0; led < geometry->n_leds; ++led)
+    {
+        if (check_terminal(geometry, led, DOWN, UP))
+        {
+            geometry->heads[geometry->n_heads++] = led;
+        }
+        if (check_terminal(geometry, led, UP, DOWN))
+        {
+            geometry->springs[geometry->n_springs++] = led;
+        }
+    }
+}
+
+static void calculate_height(geometry_t* geometry)
+{
+    int16_t (*neighbor)[N_DIRS] = geometry->neighbor;
+    int16_t* height = geometry->height;
+    for (int i = 0; i < geometry->n_leds; ++i)
+        height[i] = -1;
+    for (int i = 0; i < geometry->n_leds; ++i)
+    {
+        if (height[i] != -1) //we have been here already
+            continue;
+
+        int down = neighbor[i][DOWN];
+        int depth = 0;
+        while (down != -1 && height[down] == -1)
+        {
+            depth++;
+            down = neighbor[down][DOWN];
+        }
+        if (down != -1) //we are not at the bottom but we were here already
+        {
+            depth += height[down] + 1;
+        }
+        height[i] = depth;
+        down = neighbor[i][DOWN];
+        while (down != -1 && height[down] == -1)
+        {
+            height[down] = --depth;
+            down = neighbor[down][DOWN];
+        }
+    }
+}
+
+/*! Springs are ring 1, every step up is the next ring */
+static void calculate_rings(geometry_t* geometry)
+{
+    for (int spring = 0; spring < geometry->n_springs; ++spring)
+    {
+        geometry->ring[geometry->springs[spring]] = 1;
+    }
+    int ring = 1;
+    int up_found = 1;
+    while (up_found)
+    {
+        up_found = 0;
+        for (int led = 0; led < geometry->n_leds; ++led)
+        {
+            if (geometry->ring[led] == ring && geometry->neighbor[led][UP] != -1)
+            {
+                geometry->ring[geometry->neighbor[led][UP]] = ring + 1;
+                up_found = 1;
+            }
+        }
+        ring++;
+    }
+}
+
+static void build_adjacent(geometry_t* geometry)
+{
+    int n = 0;
+    for (int led = 0; led < geometry->n_leds; ++led)
+    {
+        geometry->adjacent_start[led] = n;
+        for (int dir = 0; dir < N_COMPASS_DIRS; ++dir)
+        {
+            if (geometry->neighbor[led][dir] != -1)
+            {
+                geometry->adjacent[n] = geometry->neighbor[led][dir];
+                geometry->adjacent_distance[n] = geometry->distance[led][dir];
+                n++;
+            }
+        }
+    }
+    geometry->adjacent_start[geometry->n_leds] = n;
+}
+
+static int read_text(geometry_t* geometry, const char* text_file, int n_leds)
+{
+    FILE* fgeom = fopen(text_file, "r");
+    if (fgeom == NULL) {
+        printf("Geometry file not found\n");
+        return 0;
+    }
+    int (*rows)[2 * N_COMPASS_DIRS] = malloc(sizeof(*rows) * n_leds);
+    for (int row = 0; row < n_leds; ++row)
+    {
+        int n = fscanf(fgeom, "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+            &rows[row][2 * UP], &rows[row][2 * UP + 1], &rows[row][2 * RIGHT], &rows[row][2 * RIGHT + 1],
+            &rows[row][2 * DOWN], &rows[row][2 * DOWN + 1], &rows[row][2 * LEFT], &rows[row][2 * LEFT + 1]);
+        if (n != 8)
+        {
+            printf("Error reading geometry\n");
+            free(rows);
+            fclose(fgeom);
+            return 0;
+        }
+    }
+    fclose(fgeom);
+
+    int n_adjacent = 0;
+    for (int row = 0; row < n_leds; ++row)
+        for (int dir = 0; dir < N_COMPASS_DIRS; ++dir)
+            n_adjacent += rows[row][2 * dir] != -1 && rows[row][2 * dir] < n_leds;
+    alloc_arrays(geometry, n_leds, n_adjacent);
+    for (int row = 0; row < n_leds; ++row)
+    {
+        for (int dir = 0; dir < N_COMPASS_DIRS; ++dir)
+        {
+            //the file can describe more leds than we have, neighbours beyond the end are dropped
+            geometry->neighbor[row][dir] = (rows[row][2 * dir] < n_leds) ? (int16_t)rows[row][2 * dir] : -1;
+            geometry->distance[row][dir] = (uint8_t)rows[row][2 * dir + 1];
+        }
+        geometry->neighbor[row][FORWARD] = row + 1;
+        geometry->distance[row][FORWARD] = 1;
+        geometry->neighbor[row][BACKWARD] = row - 1;
+        geometry->distance[row][BACKWARD] = 1;
+    }
+    free(rows);
+    // the last led has its FORWARD neighbor set to n_leds not
+    geometry->neighbor[n_leds - 1][FORWARD] = -1;
+    calculate_height(geometry);
+    find_heads_and_springs(geometry);
+    calculate_rings(geometry);
+    build_adjacent(geometry);
+    return 1;
+}
+
+static int read_binary(geometry_t* geometry, const char* binary_file, int n_leds)
+{
+    FILE* fbin = fopen(binary_file, "rb");
+    if (fbin == NULL)
+        return 0;
+    struct geometry_header header;
+    if (fread(&header, sizeof(header), 1, fbin) != 1 || header.magic != GEOMETRY_MAGIC || header.version != GEOMETRY_VERSION)
+    {
+        printf("%s is not a compiled geometry, or it is an old version\n", binary_file);
+        fclose(fbin);
+        return 0;
+    }
+    if ((int)header.n_leds != n_leds)
+    {
+        printf("%s was compiled for %i leds, not %i\n", binary_file, header.n_leds, n_leds);
+        fclose(fbin);
+        return 0;
+    }
+    alloc_arrays(geometry, n_leds, header.n_adjacent);
+    geometry->n_heads = header.n_heads;
+    geometry->n_springs = header.n_springs;
+    int ok =
+        fread(geometry->neighbor, sizeof(*geometry->neighbor), n_leds, fbin) == (size_t)n_leds &&
+        fread(geometry->distance, sizeof(*geometry->distance), n_leds, fbin) == (size_t)n_leds &&
+        fread(geometry->height, sizeof(int16_t), n_leds, fbin) == (size_t)n_leds &&
+        fread(geometry->ring, sizeof(int16_t), n_leds, fbin) == (size_t)n_leds &&
+        fread(geometry->adjacent_start, sizeof(uint16_t), n_leds + 1, fbin) == (size_t)n_leds + 1 &&
+        fread(geometry->adjacent, sizeof(uint16_t), header.n_adjacent, fbin) == header.n_adjacent &&
+        fread(geometry->adjacent_distance, sizeof(uint8_t), header.n_adjacent, fbin) == header.n_adjacent &&
+        fread(geometry->heads, sizeof(int16_t), header.n_heads, fbin) == header.n_heads &&
+        fread(geometry->springs, sizeof(int16_t), header.n_springs, fbin) == header.n_springs;
+    fclose(fbin);
+    if (!ok)
+    {
+        printf("%s is truncated\n", binary_file);
+        Geometry_free(geometry);
+    }
+    return ok;
+}
+
+static int write_binary(geometry_t* geometry, const char* binary_file)
+{
+    FILE* fbin = fopen(binary_file, "wb");
+    if (fbin == NULL)
+    {
+        printf("Cannot write %s\n", binary_file);
+        return 0;
+    }
+    int n_leds = geometry->n_leds;
+    struct geometry_header header = {
+        .magic = GEOMETRY_MAGIC,
+        .version = GEOMETRY_VERSION,
+        .n_leds = n_leds,
+        .n_adjacent = geometry->n_adjacent,
+        .n_heads = geometry->n_heads,
+        .n_springs = geometry->n_springs
+    };
+    fwrite(&header, sizeof(header), 1, fbin);
+    fwrite(geometry->neighbor, sizeof(*geometry->neighbor), n_leds, fbin);
+    fwrite(geometry->distance, sizeof(*geometry->distance), n_leds, fbin);
+    fwrite(geometry->height, sizeof(int16_t), n_leds, fbin);
+    fwrite(geometry->ring, sizeof(int16_t), n_leds, fbin);
+    fwrite(geometry->adjacent_start, sizeof(uint16_t), n_leds + 1, fbin);
+    fwrite(geometry->adjacent, sizeof(uint16_t), geometry->n_adjacent, fbin);
+    fwrite(geometry->adjacent_distance, sizeof(uint8_t), geometry->n_adjacent, fbin);
+    fwrite(geometry->heads, sizeof(int16_t), geometry->n_heads, fbin);
+    fwrite(geometry->springs, sizeof(int16_t), geometry->n_springs, fbin);
+    return fclose(fbin) == 0;
+}
+
+/*!
+ * Dijkstra from `origin`, cut off at `limit`. The wave front is small compared to the tree, so the next LED
+ * to settle is found by scanning the frontier. `dist` must be -1 everywhere on entry, settled LEDs are left
+ * with their distance
+ * @returns number of LEDs written to `out`, sorted by distance
+ */
+static int dijkstra(const geometry_t* geometry, int origin, int limit, int* dist, int* frontier, uint16_t* out)
+{
+    int n_found = 0;
+    int n_frontier = 1;
+    frontier[0] = origin;
+    dist[origin] = 0;
+    while (n_frontier > 0)
+    {
+        int best = 0;
+        for (int i = 1; i < n_frontier; ++i)
+            if (dist[frontier[i]] < dist[frontier[best]])
+                best = i;
+        int led = frontier[best];
+        frontier[best] = frontier[--n_frontier];
+        out[n_found++] = led;
+        for (uint32_t a = geometry->adjacent_start[led]; a < geometry->adjacent_start[led + 1]; ++a)
+        {
+            int next = geometry->adjacent[a];
+            int d = dist[led] + geometry->adjacent_distance[a];
+            if (d > limit || (dist[next] != -1 && dist[next] <= d))
+                continue;
+            if (dist[next] == -1)
+                frontier[n_frontier++] = next;
+            dist[next] = d;
+        }
+    }
+    return n_found;
+}
+
+/*! LEDs up to GEOMETRY_INDEX_RADIUS from `origin`, sorted by distance */
+static int find_near(const geometry_t* geometry, int origin, int* dist, int* frontier, uint16_t* out, uint8_t* out_distance)
+{
+    int n_found = dijkstra(geometry, origin, GEOMETRY_INDEX_RADIUS, dist, frontier, out);
+    //reset only what we touched, so that the next search starts clean
+    for (int i = 0; i < n_found; ++i)
+    {
+        out_distance[i] = dist[out[i]];
+        dist[out[i]] = -1;
+    }
+    return n_found;
+}
+
+/*! @returns 1 on success, 0 if out of memory, the index is left empty then */
+static int build_index(geometry_t* geometry)
+{
+    int n_leds = geometry->n_leds;
+    int* dist = malloc(sizeof(int) * n_leds);
+    int* frontier = malloc(sizeof(int) * n_leds);
+    uint16_t* found = malloc(sizeof(uint16_t) * n_leds);
+    uint8_t* found_distance = malloc(sizeof(uint8_t) * n_leds);
+    if (dist == NULL || frontier == NULL || found == NULL || found_distance == NULL)
+    {
+        printf("Geometry: not enough memory for the spatial index\n");
+        free(dist);
+        free(frontier);
+        free(found);
+        free(found_distance);
+        return 0;
+    }
+    for (int led = 0; led < n_leds; ++led)
+        dist[led] = -1;
+
+    //first pass only counts, so that the index is one tight allocation
+    uint32_t total = 0;
+    for (int led = 0; led < n_leds; ++led)
+        total += find_near(geometry, led, dist, frontier, found, found_distance);
+    geometry->near_start = malloc(sizeof(*geometry->near_start) * n_leds);
+    geometry->near = malloc(sizeof(uint16_t) * total);
+    geometry->near_distance = malloc(sizeof(uint8_t) * total);
+    if (geometry->near_start != NULL && geometry->near != NULL && geometry->near_distance != NULL)
+    {
+        uint32_t offset = 0;
+        for (int led = 0; led < n_leds; ++led)
+        {
+            int n = find_near(geometry, led, dist, frontier, found, found_distance);
+            memcpy(geometry->near + offset, found, sizeof(uint16_t) * n);
+            memcpy(geometry->near_distance + offset, found_distance, sizeof(uint8_t) * n);
+            int i = 0;
+            for (int d = 0; d <= GEOMETRY_INDEX_RADIUS + 1; ++d)
+            {
+                while (i < n && found_distance[i] < d)
+                    i++;
+                geometry->near_start[led][d] = offset + i;
+            }
+            offset += n;
+        }
+    }
+    free(dist);
+    free(frontier);
+    free(found);
+    free(found_distance);
+
+    //counting sort by height
+    geometry->max_height = 0;
+    for (int led = 0; led < n_leds; ++led)
+        if (geometry->height[led] > geometry->max_height)
+            geometry->max_height = geometry->height[led];
+    geometry->height_start = calloc(geometry->max_height + 2, sizeof(uint16_t));
+    geometry->by_height = malloc(sizeof(uint16_t) * n_leds);
+    uint16_t* fill = malloc(sizeof(uint16_t) * (geometry->max_height + 1));
+    if (geometry->near_start == NULL || geometry->near == NULL || geometry->near_distance == NULL ||
+        geometry->height_start == NULL || geometry->by_height == NULL || fill == NULL)
+    {
+        printf("Geometry: not enough memory for the spatial index\n");
+        free(fill);
+        free_index(geometry);
+        return 0;
+    }
+    for (int led = 0; led < n_leds; ++led)
+        geometry->height_start[geometry->height[led] + 1]++;
+    for (int h = 0; h <= geometry->max_height; ++h)
+        geometry->height_start[h + 1] += geometry->height_start[h];
+    memcpy(fill, geometry->height_start, sizeof(uint16_t) * (geometry->max_height + 1));
+    for (int led = 0; led < n_leds; ++led)
+        geometry->by_height[fill[geometry->height[led]]++] = led;
+    free(fill);
+    return 1;
+}
+
+/*! The index takes a Dijkstra from every LED, so it is only built once some effect asks for it */
+static int has_index(geometry_t* geometry)
+{
+    return geometry->near != NULL || build_index(geometry);
+}
+
+geometry_span_t Geometry_within(geometry_t* geometry, int led, int radius)
+{
+    geometry_span_t span = { NULL, NULL, 0 };
+    if (!has_index(geometry))
+        return span;
+    if (radius > GEOMETRY_INDEX_RADIUS)
+        radius = GEOMETRY_INDEX_RADIUS;
+    uint32_t start = geometry->near_start[led][0];
+    uint32_t end = (radius < 0) ? start : geometry->near_start[led][radius + 1];
+    span.leds = geometry->near + start;
+    span.distance = geometry->near_distance + start;
+    span.count = (int)(end - start);
+    return span;
+}
+
+geometry_span_t Geometry_ring(geometry_t* geometry, int led, int radius)
+{
+    geometry_span_t span = { NULL, NULL, 0 };
+    if (radius < 0 || radius > GEOMETRY_INDEX_RADIUS || !has_index(geometry))
+        return span;
+    uint32_t start = geometry->near_start[led][radius];
+    span.leds = geometry->near + start;
+    span.distance = geometry->near_distance + start;
+    span.count = (int)(geometry->near_start[led][radius + 1] - start);
+    return span;
+}
+
+geometry_span_t Geometry_height_band(geometry_t* geometry, int from, int to)
+{
+    geometry_span_t span = { NULL, NULL, 0 };
+    if (!has_index(geometry))
+        return span;
+    if (from < 0)
+        from = 0;
+    if (to > geometry->max_height + 1)
+        to = geometry->max_height + 1;
+    span.leds = geometry->by_height;
+    if (from >= to)
+        return span;
+    span.leds = geometry->by_height + geometry->height_start[from];
+    span.count = geometry->height_start[to] - geometry->height_start[from];
+    return span;
+}
+
+static geometry_field_t* build_field(const geometry_t* geometry, int seed)
+{
+    int n_leds = geometry->n_leds;
+    geometry_field_t* field = malloc(sizeof(geometry_field_t));
+    field->seed = seed;
+    field->hops = malloc(sizeof(uint16_t) * n_leds);
+    field->distance = malloc(sizeof(uint16_t) * n_leds);
+    field->max_hops = 0;
+    field->max_distance = 0;
+    for (int led = 0; led < n_leds; ++led)
+    {
+        field->hops[led] = GEOMETRY_UNREACHABLE;
+        field->distance[led] = GEOMETRY_UNREACHABLE;
+    }
+
+    //breadth first for hops, the queue doubles as the list of visited LEDs
+    uint16_t* queue = malloc(sizeof(uint16_t) * n_leds);
+    int head = 0, tail = 0;
+    queue[tail++] = seed;
+    field->hops[seed] = 0;
+    while (head < tail)
+    {
+        int led = queue[head++];
+        for (uint32_t a = geometry->adjacent_start[led]; a < geometry->adjacent_start[led + 1]; ++a)
+        {
+            int next = geometry->adjacent[a];
+            if (field->hops[next] != GEOMETRY_UNREACHABLE)
+                continue;
+            field->hops[next] = field->hops[led] + 1;
+            field->max_hops = field->hops[next];
+            queue[tail++] = next;
+        }
+    }
+
+    //Dijkstra without the limit for distances
+    int* dist = malloc(sizeof(int) * n_leds);
+    int* frontier = malloc(sizeof(int) * n_leds);
+    for (int led = 0; led < n_leds; ++led)
+        dist[led] = -1;
+    int n_found = dijkstra(geometry, seed, GEOMETRY_UNREACHABLE - 1, dist, frontier, queue);
+    for (int i = 0; i < n_found; ++i)
+        field->distance[queue[i]] = dist[queue[i]];
+    field->max_distance = dist[queue[n_found - 1]];
+    free(dist);
+    free(frontier);
+    free(queue);
+    return field;
+}
+
+const geometry_field_t* Geometry_field(geometry_t* geometry, int seed)
+{
+    if (geometry->fields == NULL)
+        geometry->fields = calloc(geometry->n_leds, sizeof(geometry_field_t*));
+    if (geometry->fields[seed] == NULL)
+        geometry->fields[seed] = build_field(geometry, seed);
+    return geometry->fields[seed];
+}
+
+int Geometry_load(geometry_t* geometry, int n_leds)
+{
+    if (!read_binary(geometry, GEOMETRY_BINARY_FILE, n_leds) && !read_text(geometry, GEOMETRY_TEXT_FILE, n_leds))
+        return 0;
+    //debug output
+    printf("HEADS: ");
+    for (int i = 0; i < geometry->n_heads; ++i) printf("%d, ", geometry->heads[i]);
+    printf("\nSPRINGS: ");
+    for (int i = 0; i < geometry->n_springs; ++i) printf("%d, ", geometry->springs[i]);
+    printf("\n");
+    return 1;
+}
+
+int Geometry_compile(const char* text_file, const char* binary_file, int n_leds)
+{
+    geometry_t geometry;
+    if (!read_text(&geometry, text_file, n_leds))
+        return 0;
+    int ok = write_binary(&geometry, binary_file);
+    if (ok)
+        printf("Geometry of %i leds compiled to %s: %i heads, %i springs, %i adjacent pairs\n",
+            n_leds, binary_file, geometry.n_heads, geometry.n_springs, geometry.n_adjacent);
+    Geometry_free(&geometry);
+    return ok;
+}
@@ -0,0 +1,197 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include "ws2811.h"
+#else
+#include "fakeled.h"
+#endif // __linux__
+
+#include "colours.h"
+#include "keyframes.h"
+
+int Keyframes_init(keyframes_t* keyframes, int n_leds, int capacity)
+{
+    memset(keyframes, 0, sizeof(*keyframes));
+    keyframes->n_leds = n_leds;
+    keyframes->capacity = capacity;
+    keyframes->current = -1;
+    keyframes->colors = malloc(sizeof(ws2811_led_t) * n_leds * capacity);
+    keyframes->interval = malloc(sizeof(int) * capacity);
+    keyframes->easing = malloc(sizeof(uint8_t) * capacity);
+    if (!keyframes->colors || !keyframes->interval || !keyframes->easing)
+    {
+        Keyframes_free(keyframes);
+        return 0;
+    }
+    return 1;
+}
+
+void Keyframes_free(keyframes_t* keyframes)
+{
+    free(keyframes->colors);
+    free(keyframes->interval);
+    free(keyframes->easing);
+    memset(keyframes, 0, sizeof(*keyframes));
+    keyframes->current = -1;
+}
+
+int Keyframes_reserve(keyframes_t* keyframes, int capacity)
+{
+    if (capacity <= keyframes->capacity)
+        return 1;
+    int new_capacity = (keyframes->capacity > 0) ? keyframes->capacity : 1;
+    while (new_capacity < capacity)
+        new_capacity *= 2;
+    ws2811_led_t* colors = realloc(keyframes->colors, sizeof(ws2811_led_t) * keyframes->n_leds * new_capacity);
+    if (!colors)
+        return 0;
+    keyframes->colors = colors;
+    int* interval = realloc(keyframes->interval, sizeof(int) * new_capacity);
+    if (!interval)
+        return 0;
+    keyframes->interval = interval;
+    uint8_t* easing = realloc(keyframes->easing, sizeof(uint8_t) * new_capacity);
+    if (!easing)
+        return 0;
+    keyframes->easing = easing;
+    keyframes->capacity = new_capacity;
+    return 1;
+}
+
+ws2811_led_t* Keyframes_insert(keyframes_t* keyframes, int position)
+{
+    if (position < 0 || position > keyframes->n || !Keyframes_reserve(keyframes, keyframes->n + 1))
+        return NULL;
+    int n_leds = keyframes->n_leds;
+    int behind = keyframes->n - position;
+    memmove(keyframes->colors + (position + 1) * n_leds, keyframes->colors + position * n_leds, sizeof(ws2811_led_t) * n_leds * behind);
+    memmove(keyframes->interval + position + 1, keyframes->interval + position, sizeof(int) * behind);
+    memmove(keyframes->easing + position + 1, keyframes->easing + position, sizeof(uint8_t) * behind);
+    keyframes->interval[position] = KF_DEFAULT_INTERVAL;
+    keyframes->easing[position] = KE_LINEAR;
+    keyframes->n++;
+    return keyframes->colors + position * n_leds;
+}
+
+void Keyframes_clear(keyframes_t* keyframes)
+{
+    keyframes->n = 0;
+    keyframes->current = -1;
+}
+
+int Keyframes_remove(keyframes_t* keyframes, int position)
+{
+    if (position < 0 || position >= keyframes->n)
+        return 0;
+    int n_leds = keyframes->n_leds;
+    int behind = keyframes->n - position - 1;
+    memmove(keyframes->colors + position * n_leds, keyframes->colors + (position + 1) * n_leds, sizeof(ws2811_led_t) * n_leds * behind);
+    memmove(keyframes->interval + position, keyframes->interval + position + 1, sizeof(int) * behind);
+    memmove(keyframes->easing + position, keyframes->easing + position + 1, sizeof(uint8_t) * behind);
+    keyframes->n--;
+    return 1;
+}
+
+int Keyframes_swap(keyframes_t* keyframes, int position1, int position2)
+{
+    if (position1 < 0 || position1 >= keyframes->n || position2 < 0 || position2 >= keyframes->n)
+        return 0;
+    ws2811_led_t* colors1 = keyframes->colors + position1 * keyframes->n_leds;
+    ws2811_led_t* colors2 = keyframes->colors + position2 * keyframes->n_leds;
+    for (int led = 0; led < keyframes->n_leds; ++led)
+    {
+        ws2811_led_t c = colors1[led];
+        colors1[led] = colors2[led];
+        colors2[led] = c;
+    }
+    int interval = keyframes->interval[position1];
+    keyframes->interval[position1] = keyframes->interval[position2];
+    keyframes->interval[position2] = interval;
+    uint8_t easing = keyframes->easing[position1];
+    keyframes->easing[position1] = keyframes->easing[position2];
+    keyframes->easing[position2] = easing;
+    return 1;
+}
+
+ws2811_led_t* Keyframes_frame(keyframes_t* keyframes, int position)
+{
+    if (position < 0 || position >= keyframes->n)
+        return NULL;
+    return keyframes->colors + position * keyframes->n_leds;
+}
+
+int Keyframes_set_timing(keyframes_t* keyframes, int position, int interval, keyframe_easing_t easing)
+{
+    if (position < 0 || position >= keyframes->n || easing < 0 || easing >= N_KEYFRAME_EASINGS)
+        return 0;
+    keyframes->interval[position] = (interval < 1) ? 1 : interval;
+    keyframes->easing[position] = easing;
+    return 1;
+}
+
+void Keyframes_start(keyframes_t* keyframes, uint64_t current_time)
+{
+    keyframes->current = (keyframes->n > 0) ? 0 : -1;
+    keyframes->frame_start = current_time;
+}
+
+void Keyframes_stop(keyframes_t* keyframes)
+{
+    keyframes->current = -1;
+}
+
+/*! @returns `t` from 0 to 1 along the curve */
+static float ease(keyframe_easing_t easing, float t)
+{
+    switch (easing)
+    {
+    case KE_SMOOTH:
+        return t * t * (3.0f - 2.0f * t);
+    case KE_EASE_IN:
+        return t * t;
+    case KE_EASE_OUT:
+        return t * (2.0f - t);
+    case KE_HOLD:
+        return 0.0f;
+    case KE_LINEAR:
+    default:
+        return t;
+    }
+}
+
+int Keyframes_render(keyframes_t* keyframes, uint64_t current_time, ws2811_led_t* out)
+{
+    if (keyframes->current < 0 || keyframes->n == 0)
+        return 0;
+    if (keyframes->current >= keyframes->n) //frames were removed under the animation
+        keyframes->current = 0;
+    uint64_t elapsed = (current_time > keyframes->frame_start) ? current_time - keyframes->frame_start : 0;
+    uint64_t length = (uint64_t)keyframes->interval[keyframes->current] * 1000000;
+    if (elapsed >= length)
+    {
+        //after a long pause skip whole loops of the animation at once
+        uint64_t loop = 0;
+        for (int f = 0; f < keyframes->n; ++f)
+            loop += (uint64_t)keyframes->interval[f] * 1000000;
+        elapsed %= loop;
+        keyframes->frame_start = current_time - elapsed;
+        length = (uint64_t)keyframes->interval[keyframes->current] * 1000000;
+        while (elapsed >= length)
+        {
+            elapsed -= length;
+            keyframes->frame_start += length;
+            keyframes->current = (keyframes->current + 1) % keyframes->n;
+            length = (uint64_t)keyframes->interval[keyframes->current] * 1000000;
+        }
+    }
+    int next = (keyframes->current + 1) % keyframes->n;
+    const ws2811_led_t* from = keyframes->colors + keyframes->current * keyframes->n_leds;
+    const ws2811_led_t* to = keyframes->colors + next * keyframes->n_leds;
+    float t = ease((keyframe_easing_t)keyframes->easing[keyframes->current], (float)elapsed / (float)length);
+    lerp_rgb_buffer(from, to, (int)(t * 256.0f), out, keyframes->n_leds);
+    return 1;
+}
@@ -17,6 +17,11 @@
 #include <czmq.h>
 
 #include "source_manager.h"
+#include "audio_capture.h"
+#include "audio_analysis.h"
+#include "audio_regression.h"
+#include "geometry.h"
+#include "replay.h"
 #include "led_main.h"
 
 //#define PRINT_FPS
@@ -78,7 +83,15 @@ struct ArgOptions arg_options =
     .clear_on_exit = 0,
     .frame_time = FRAME_TIME,
     .time_speed = 1,
-    .source_type = IP_SOURCE
+    .source_type = IP_SOURCE,
+    .audio_file = NULL,
+    .benchmark = 0,
+    .trace_file = NULL,
+    .golden_file = NULL,
+    .geometry_file = NULL,
+    .record_file = NULL,
+    .replay_file = NULL,
+    .seed = 0
 };
 
 void parseargs(int argc, char **argv)
@@ -97,10 +110,18 @@ void parseargs(int argc, char **argv)
         {"nleds", required_argument, 0, 'n'},
         {"gpio", required_argument, 0, 'g'},
         {"strip", required_argument, 0, 'p'},
+        {"audio_file", required_argument, 0, 'a'},
+        {"benchmark", no_argument, 0, 'b'},
+        {"offline", required_argument, 0, 'o'},
+        {"reference", required_argument, 0, 'r'},
+        {"compile_geometry", required_argument, 0, 'x'},
+        {"record", required_argument, 0, 'w'},
+        {"replay", required_argument, 0, 'y'},
+        {"seed", required_argument, 0, 'S'},
 		{0, 0, 0, 0}
 	};
 
-    static const char shortopts[] = "hcvt:s:f:n:g:p:";
+    static const char shortopts[] = "hcvt:s:f:n:g:p:a:bo:r:x:w:y:S:";
 
 	while (1)
 	{
@@ -128,6 +149,14 @@ void parseargs(int argc, char **argv)
                 "-n (--nleds)      - number of leds on string (100 on disco LEDs, 454 in gazebo)\n"
                 "-g (--gpio)       - GPIO to use (12 on disco light Raspberry, 18 on the Raspberry in gazebo)\n"
                 "-p (--strip)      - strip type - rgb (disco LEDs) or grb (Gazebo)\n"
+                "-a (--audio_file) - wav file (16 bit stereo) to use for DISCO instead of the sound card\n"
+                "-b (--benchmark)  - run microbenchmarks and exit\n"
+                "-o (--offline)    - run the audio file once on a virtual clock and write per frame trace to this file, with -y trace the replay\n"
+                "-r (--reference)  - with -o, compare the trace against this golden trace, exit code is 1 if any frame differs\n"
+                "-x (--compile_geometry) - compile geometry for -n leds into this binary file (geometry.bin is loaded by XMAS) and exit\n"
+                "-w (--record)     - record seed, frame times, controller buttons and messages to this file\n"
+                "-y (--replay)     - replay a recorded session headless on its own clock, as fast as possible, and exit\n"
+                "-S (--seed)       - seed of the random streams of the sources, 0 by default\n"
 				, argv[0]);
 			exit(-1);
 		case 'c':
@@ -183,44 +212,190 @@ void parseargs(int argc, char **argv)
                 }
             }
             break;
+        case 'a':
+            if (optarg) {
+                arg_options.audio_file = optarg;
+            }
+            break;
+        case 'b':
+            arg_options.benchmark = 1;
+            break;
+        case 'o':
+            if (optarg) {
+                arg_options.trace_file = optarg;
+            }
+            break;
+        case 'r':
+            if (optarg) {
+                arg_options.golden_file = optarg;
+            }
+            break;
+        case 'x':
+            if (optarg) {
+                arg_options.geometry_file = optarg;
+            }
+            break;
+        case 'w':
+            if (optarg) {
+                arg_options.record_file = optarg;
+            }
+            break;
+        case 'y':
+            if (optarg) {
+                arg_options.replay_file = optarg;
+            }
+            break;
+        case 'S':
+            if (optarg) {
+                arg_options.seed = (uint32_t)strtoul(optarg, NULL, 10);
+            }
+            break;
         }
     }
 }
 
+/*!
+ * @brief Runs on a virtual clock don't need the hardware (nor root), the LEDs are then only a buffer in memory
+ * @param headless 1 to allocate the buffer instead of initializing the hardware
+ */
+static ws2811_return_t init_leds(int headless)
+{
+    if (!headless)
+        return ws2811_init(&ledstring);
+    ledstring.channel[0].leds = calloc(ledstring.channel[0].count, sizeof(ws2811_led_t));
+    return (ledstring.channel[0].leds != NULL) ? WS2811_SUCCESS : WS2811_ERROR_OUT_OF_MEMORY;
+}
+
+static void fini_leds(int headless)
+{
+    if (!headless)
+    {
+        ws2811_fini(&ledstring);
+        return;
+    }
+    free(ledstring.channel[0].leds);
+    ledstring.channel[0].leds = NULL;
+}
 
 int main(int argc, char *argv[])
 {
     printf("Starting\n");
     ws2811_return_t ret;
     parseargs(argc, argv);
+    if (arg_options.benchmark)
+    {
+        AudioCapture_benchmark();
+        return 0;
+    }
+    if (arg_options.geometry_file)
+    {
+        return Geometry_compile(GEOMETRY_TEXT_FILE, arg_options.geometry_file, ledstring.channel[0].count) ? 0 : -1;
+    }
+    int replay = arg_options.replay_file != NULL;
+    replay_header_t replay_header;
+    if (replay)
+    {
+        //the session starts exactly as it was recorded, the command line is ignored
+        Replay_start_playback(arg_options.replay_file, &replay_header);
+        arg_options.seed = replay_header.seed;
+        arg_options.source_type = replay_header.source_type;
+        arg_options.time_speed = replay_header.time_speed;
+        arg_options.frame_time = replay_header.frame_time;
+        ledstring.channel[0].count = replay_header.led_count;
+        if (arg_options.trace_file)
+            AudioRegression_init(arg_options.trace_file, arg_options.golden_file);
+    }
+    int offline = arg_options.trace_file != NULL && !replay;
+    if (offline)
+    {
+        if (!arg_options.audio_file)
+        {
+            fprintf(stderr, "Offline run needs an audio file (-a)\n");
+            return -1;
+        }
+        AudioCapture_set_offline();
+        //the run is driven by the audio, also when the source does not use it
+        AudioAnalysis_start(arg_options.frame_time, arg_options.audio_file);
+        AudioRegression_init(arg_options.trace_file, arg_options.golden_file);
+    }
     int led_count = ledstring.channel[0].count;
+    int headless = offline || replay;
 
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC_RAW, &now);
-    uint64_t last_update_ns = now.tv_sec * (long long)1e9 + now.tv_nsec;
+    uint64_t last_update_ns = offline ? 0 : now.tv_sec * (long long)1e9 + now.tv_nsec;
     long frame = 0;
-    SourceManager_init(arg_options.source_type, led_count, arg_options.time_speed, last_update_ns);
+    if (replay)
+    {
+        last_update_ns = replay_header.start_ns;
+    }
+    else if (arg_options.record_file)
+    {
+        replay_header = (replay_header_t){
+            .seed = arg_options.seed,
+            .source_type = arg_options.source_type,
+            .led_count = led_count,
+            .time_speed = arg_options.time_speed,
+            .frame_time = arg_options.frame_time,
+            .start_ns = last_update_ns
+        };
+        Replay_start_recording(arg_options.record_file, &replay_header);
+    }
+    SourceManager_init(arg_options.source_type, led_count, arg_options.time_speed, arg_options.seed, last_update_ns);
     printf("Init source with %i leds\n", led_count);
 
     setup_handlers();
 
-    if ((ret = ws2811_init(&ledstring)) != WS2811_SUCCESS)
+    if ((ret = init_leds(headless)) != WS2811_SUCCESS)
     {
         fprintf(stderr, "ws2811_init failed: %s\n", ws2811_get_return_t_str(ret));
         return ret;
     }
     printf("Init successful\n");
-    srand(0); //for testing we want random to be stable
 
 #ifdef PRINT_FPS
     uint64_t fps_time_ns = 0;
 #endif
     while (running)
     {
+        frame++;
+        uint64_t current_ns;
+        if (replay)
+        {
+            //virtual clock with the recorded frame times, inputs come from the recording and we never sleep
+            uint64_t time_delta;
+            if (!Replay_next_frame(&time_delta))
+            {
+                running = 0;
+                continue;
+            }
+            current_ns = last_update_ns + time_delta;
+            SourceManager_set_time(current_ns, time_delta);
+            last_update_ns = current_ns;
+            SourceManager_update_leds(frame, &ledstring);
+            check_message();
+            if (arg_options.trace_file)
+                AudioRegression_record(frame, &ledstring);
+            continue;
+        }
+        if (offline)
+        {
+            //virtual clock, every frame is exactly frame_time long and we never sleep
+            current_ns = last_update_ns + arg_options.frame_time * 1000;
+            SourceManager_set_time(current_ns, current_ns - last_update_ns);
+            if (Replay_get_mode() == RM_RECORD)
+                Replay_write_frame(current_ns - last_update_ns);
+            last_update_ns = current_ns;
+            AudioCapture_step();
+            SourceManager_update_leds(frame, &ledstring);
+            AudioRegression_record(frame, &ledstring);
+            if (AudioCapture_is_finished())
+                running = 0;
+            continue;
+        }
         clock_gettime(CLOCK_MONOTONIC_RAW, &now);
-        uint64_t current_ns = now.tv_sec * (long long)1e9 + now.tv_nsec;
+        current_ns = now.tv_sec * (long long)1e9 + now.tv_nsec;
         uint64_t delta_us = (current_ns - last_update_ns) / (long)1e3;
-        frame++;
 #ifdef PRINT_FPS	
         if(frame % FPS_SAMPLES == 0)
         {
@@ -241,6 +416,8 @@ int main(int argc, char *argv[])
         clock_gettime(CLOCK_MONOTONIC_RAW, &now);
         current_ns = now.tv_sec * (long long)1e9 + now.tv_nsec;
         SourceManager_set_time(current_ns, current_ns - last_update_ns);
+        if (Replay_get_mode() == RM_RECORD)
+            Replay_write_frame(current_ns - last_update_ns);
         last_update_ns = current_ns;
         if (SourceManager_update_leds(frame, &ledstring))
         {
@@ -260,13 +437,27 @@ int main(int argc, char *argv[])
         {
             ledstring.channel[0].leds[i] = 0x00; //GBR: FF0000 - blue, FF00 - green, FF - red;  RGB: FF0000 - green, FF00 - red, FF - blue
         }
-    	ws2811_render(&ledstring);
+        if (!headless)
+            ws2811_render(&ledstring);
     }
 
     SourceConfig_destruct();
     SourceManager_destruct_source();
-    ws2811_fini(&ledstring);
+    fini_leds(headless);
 
+    if (offline)
+    {
+        AudioAnalysis_stop();
+        ret = (AudioRegression_finish() > 0) ? 1 : 0; //the count is in the summary, the exit status is cut to 8 bits
+    }
+    if (replay && arg_options.trace_file)
+    {
+        ret = (AudioRegression_finish() > 0) ? 1 : 0;
+    }
+    if (Replay_get_mode() != RM_OFF && Replay_finish() > 0)
+    {
+        ret = 1; //the number of diverged inputs is in the summary
+    }
     printf ("Finished\n");
     return ret;
 }
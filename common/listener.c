@@ -5,40 +5,62 @@
 #include <czmq.h>
 
 #include "listener.h"
+#include "replay.h"
 
 static struct Listener listener;
 
 int Listener_init()
 {
+    if (Replay_get_mode() == RM_PLAY) //messages come from the recording
+        return 0;
     listener.context = zmq_ctx_new();
     listener.subscriber = zmq_socket(listener.context, ZMQ_SUB);
     int rc = zmq_connect(listener.subscriber, LISTENER_ADDRESS);
     assert(rc == 0);
     rc = zmq_setsockopt(listener.subscriber, ZMQ_SUBSCRIBE, "LED", 3);
     assert(rc == 0);
+    int64_t max_size = LISTENER_MAX_MESSAGE;
+    rc = zmq_setsockopt(listener.subscriber, ZMQ_MAXMSGSIZE, &max_size, sizeof(max_size));
+    assert(rc == 0);
     printf("Connected\n");
     return 0;
 }
 
 void Listener_destruct()
 {
+    if (listener.context == NULL)
+        return;
     zmq_close(listener.subscriber);
     zmq_ctx_destroy(listener.context);
 }
 
-char* Listener_poll_message()
+static char* receive_message()
 {
-    char buffer[1024];
-    int size = zmq_recv(listener.subscriber, buffer, 1023, ZMQ_DONTWAIT);
+    zmq_msg_t message;
+    zmq_msg_init(&message);
+    int size = zmq_msg_recv(&message, listener.subscriber, ZMQ_DONTWAIT);
     if (size == -1)
+    {
+        zmq_msg_close(&message);
         return NULL;
-    if (size > 1023)
-        size = 1023;
-    buffer[size] = 0x0;
-#ifdef __linux__
-    return strndup(buffer, sizeof(buffer) - 1);
-#else
-    return strdup(buffer);
-#endif // __linux__
+    }
+    //the message is as long as it needs to be, no fixed buffer in between
+    char* msg = malloc(size + 1);
+    if (msg != NULL)
+    {
+        memcpy(msg, zmq_msg_data(&message), size);
+        msg[size] = 0x0;
+    }
+    zmq_msg_close(&message);
+    return msg;
 }
 
+char* Listener_poll_message()
+{
+    if (Replay_get_mode() == RM_PLAY)
+        return Replay_read_message();
+    char* msg = receive_message();
+    if (Replay_get_mode() == RM_RECORD)
+        Replay_write_message(msg);
+    return msg;
+}
@@ -237,7 +237,7 @@ int is_announcement_in_progress = 0;
 
 const int C_LED_Z = 1;          //!< 0 means there is nothing in z buffer, so led with index 0 must be 1
 const int C_SEGMENT_SHIFT = 10; //!< z buffer for jewels is (segment_index << C_SEGMENT_SHIFT) | field_index
-const int C_BULLET_Z = N_MAX_SEGMENTS << 10;    //!< bullets z index will be C_BULLET_Z + bullet
+const int C_BULLET_Z = 1 << 24;    //!< bullets z index will be C_BULLET_Z + bullet, jewels of up to 2^14 segments fit below
 
 
 /************** Utility functions ************************/
@@ -24,6 +24,7 @@
 #include "sound_player.h"
 #include "controller.h"
 #include "base64.h"
+#include "keyframes.h"
 
 #include "paint_source.h"
 #include "morse_source.h"
@@ -37,26 +38,19 @@ enum EAnimMode
     AM_MOVE_SHIMMER
 };
 
-typedef struct SAmpPhase
-{
-    float amp;
-    float phase;
-} AmpPhase_t;
+#define SHIMMER_LUT_BITS 10
+#define SHIMMER_LUT_LEN (1 << SHIMMER_LUT_BITS)
 
 static enum EAnimMode animation_mode = AM_NONE;
 static double animation_speed;
 static uint64_t animation_start;
-static hsl_t* leds;
-static int* canvas;
-static AmpPhase_t* coeffs;
-static hsl_t* key_frames[C_N_KEY_FRAMES];
-static int frame_intervals[C_N_KEY_FRAMES]; //intervals between frames in miliseconds; frame_intervals[0] is time between frame 0 and 1
-static int next_frame[C_N_KEY_FRAMES];
-static int head_frame_index;
-static int current_frame_index;
-static uint64_t frame_start;
-static const int KF_EMPTY_FRAME = -2;
-static const int KF_LAST_FRAME = -1;
+static ws2811_led_t* leds; //painted colours before animation, RGB so that key frames are just copied in
+static ws2811_led_t* canvas;
+static ws2811_led_t* moved;     //painted colours rotated by the animation, one more LED at the end wraps around
+static int16_t sin_lut[SHIMMER_LUT_LEN];    //one period of sin, 1 is 32767
+static int16_t* shimmer_amp;    //amplitude of lightness per LED, lightness 1 is 510 * 64, see shimmer_lightness
+static uint16_t* shimmer_phase; //phase per LED in sin_lut steps
+static keyframes_t key_frames;
 
 static const char* secret = "STASTNYADOBRYNOVYROKDIKYZEJSTETUSNAMIMARTINAVILMA";
 static const char* hint = "TMOUDVACETCTYRIPOMUCKA";
@@ -109,9 +103,11 @@ static void show_secret()
         Paint_letter2rygb(rygb, secret[letter]);
         for (int led = 0; led < N_PAINT_CODES; led++)
         {
-            leds[letter * N_PAINT_CODES + led].h = PAINT_RYGB_HUE[(int)rygb[led]];
-            leds[letter * N_PAINT_CODES + led].s = 1.0f;
-            leds[letter * N_PAINT_CODES + led].l = 0.4f;
+            hsl_t col;
+            col.h = PAINT_RYGB_HUE[(int)rygb[led]];
+            col.s = 1.0f;
+            col.l = 0.4f;
+            leds[letter * N_PAINT_CODES + led] = hsl2rgb(&col);
         }
     }
     animation_mode = AM_NONE;
@@ -223,10 +219,19 @@ static void generate_led_phases(float max_amp)
         max_amp *= -1.0f;
     if(max_amp > 1.0f)
         max_amp = 1.0f;
-    for (int led = 0; led < paint_source.basic_source.n_leds; led++)
-    {
-        coeffs[led].amp = max_amp * random_01() * 0.5;
-        coeffs[led].phase = random_01() * M_PI;
+    //amplitude and phase of every LED, drawn a block at a time
+    float r01[2 * 256];
+    for (int first = 0; first < paint_source.basic_source.n_leds; first += 256)
+    {
+        int n = paint_source.basic_source.n_leds - first;
+        if (n > 256)
+            n = 256;
+        random_01_n(r01, 2 * n);
+        for (int i = 0; i < n; i++)
+        {
+            shimmer_amp[first + i] = (int16_t)(max_amp * r01[2 * i] * 0.5 * 510 * 64);
+            shimmer_phase[first + i] = (uint16_t)(r01[2 * i + 1] * SHIMMER_LUT_LEN / 2); //0 to pi
+        }
     }
 }
 
@@ -254,78 +259,105 @@ static void switch_animation_mode(enum EAnimMode new_mode, double new_speed)
     animation_speed = new_speed;
 }
 
-static void update_leds_from_keyframes()
+//! @brief Painted colours moved by `distance` LEDs along the chain, the LED at `distance` comes to the start
+//! @param anti_aliased if set, the fraction of `distance` blends two neighbouring LEDs, otherwise it is dropped
+static void move_leds(double distance, int anti_aliased, ws2811_led_t* out)
 {
-    int time_ms = ((paint_source.basic_source.current_time - frame_start) / (long)1e6);
-    while (time_ms > frame_intervals[current_frame_index])
+    int n_leds = paint_source.basic_source.n_leds;
+    double whole = floor(distance);
+    int shift = (int)(whole - floor(whole / n_leds) * n_leds);
+    if (shift >= n_leds) shift = 0;
+    memcpy(moved, leds + shift, sizeof(ws2811_led_t) * (n_leds - shift));
+    memcpy(moved + n_leds - shift, leds, sizeof(ws2811_led_t) * shift);
+    moved[n_leds] = moved[0];
+    lerp_rgb_buffer(moved, moved + 1, anti_aliased ? (int)((distance - whole) * 256) : 0, out, n_leds);
+}
+
+//! @brief Add amp * sin(phase + offset) to the HSL lightness of all colours in place, without going through HSL.
+//! Hue and saturation stay when every channel keeps its distance from the lightness, scaled by the chroma
+//! 1 - |2L - 1|, i.e. c' = L' + (c - L) * (1 - |2L' - 1|) / (1 - |2L - 1|). Everything is in fixed point, the sum
+//! of the brightest and the darkest channel is 2 * 255 * L
+static void shimmer_lightness(ws2811_led_t* colors, int offset)
+{
+    for (int led = 0; led < paint_source.basic_source.n_leds; led++)
     {
-        time_ms -= frame_intervals[current_frame_index];
-        current_frame_index = next_frame[current_frame_index];
-        if (current_frame_index == KF_LAST_FRAME)
+        ws2811_led_t c = colors[led];
+        int r = (c >> 16) & 0xFF;
+        int g = (c >> 8) & 0xFF;
+        int b = c & 0xFF;
+        int vmax = r > g ? (r > b ? r : b) : (g > b ? g : b);
+        int vmin = r < g ? (r < b ? r : b) : (g < b ? g : b);
+        int sum = vmax + vmin;
+        int shifted = sum * 64 + ((shimmer_amp[led] * sin_lut[(shimmer_phase[led] + offset) & (SHIMMER_LUT_LEN - 1)]) >> 15);
+        if (shifted < 0) shifted = 0;
+        if (shifted > 510 * 64) shifted = 510 * 64;
+        int chroma = 255 - abs(sum - 255);
+        if (chroma == 0 || vmax == vmin)
         {
-            current_frame_index = head_frame_index;
+            int v = (shifted + 64) >> 7;
+            colors[led] = v << 16 | v << 8 | v;
+            continue;
         }
-        frame_start = paint_source.basic_source.current_time - time_ms * 1000l;
-    }
-    int next_frame_index = next_frame[current_frame_index];
-    if (next_frame_index == KF_LAST_FRAME) next_frame_index = head_frame_index;
-    double blend = (double)time_ms / (double)frame_intervals[current_frame_index];
-    for (int led = 0; led < paint_source.basic_source.n_leds; led++)
-    {
-        lerp_hsl(&key_frames[current_frame_index][led], &key_frames[next_frame_index][led], blend, &leds[led]);
+        //|2c - sum| is at most the chroma, so the products stay small
+        int scale = ((255 * 64 - abs(shifted - 255 * 64)) << 8) / chroma;
+        int channels[3] = { r, g, b };
+        ws2811_led_t out = 0;
+        for (int ch = 0; ch < 3; ch++)
+        {
+            int v = (shifted + (((2 * channels[ch] - sum) * scale) >> 8) + 64) >> 7;
+            v = v < 0 ? 0 : (v > 255 ? 255 : v);
+            out = out << 8 | v;
+        }
+        colors[led] = out;
     }
 }
 
-
 static void draw_leds_to_canvas()
 {
+    int n_leds = paint_source.basic_source.n_leds;
     double time_seconds = ((paint_source.basic_source.current_time - animation_start) / (long)1e3) / (double)1e6;
     double distance = animation_speed * time_seconds;
-    if (current_frame_index != KF_LAST_FRAME)
+    int offset = (int)((long long)floor(distance * SHIMMER_LUT_LEN / (2 * M_PI)) & (SHIMMER_LUT_LEN - 1));
+    Keyframes_render(&key_frames, paint_source.basic_source.current_time, leds);
+    switch (animation_mode)
     {
-        update_leds_from_keyframes();
-    }
-    double resonance_strength = 1.0;
-    for (int led = paint_source.basic_source.n_leds - 1; led >= 0; led--)
+    case AM_NONE:
     {
-        int index_before = (led + (int)floor(distance)) % paint_source.basic_source.n_leds;
-        // -10 % 7 = -3
-        if (index_before < 0)
-            index_before += paint_source.basic_source.n_leds;
-        int index_after = (index_before + 1) % paint_source.basic_source.n_leds;
-
-        assert(index_before >= 0 && index_before < paint_source.basic_source.n_leds);
-        assert(index_after >= 0 && index_after < paint_source.basic_source.n_leds);
-        
-        hsl_t col;
-        switch (animation_mode)
+        double resonance_strength = 1.0;
+        for (int led = n_leds - 1; led >= 0; led--)
         {
-        case AM_NONE:
-            col = leds[led];
+            //only LEDs that can still resonate need HSL, the resonance fades out quickly along the chain
             if(resonance_strength > 0.001)
             {
                 //printf("res %f\n", resonance_strength);
+                hsl_t col;
+                rgb2hsl(leds[led], &col);
                 resonance_strength = add_resonance(&col, led, time_seconds, resonance_strength);
+                canvas[led] = hsl2rgb(&col);
+            }
+            else
+            {
+                canvas[led] = leds[led];
             }
-            break;
-        case AM_MOVE_NO_AA:
-            col = leds[index_before];
-            break;
-        case AM_MOVE_AA:
-            lerp_hsl(&leds[index_before], &leds[index_after], distance - floor(distance), &col);
-            break;
-        case AM_SHIMMER:
-            col = leds[led];
-            col.l = fmax(fmin(col.l + coeffs[led].amp * sin(coeffs[led].phase + distance), 1), 0);
-            break;
-        case AM_MOVE_SHIMMER:
-            lerp_hsl(&leds[index_before], &leds[index_after], distance - floor(distance), &col);
-            col.l = fmax(fmin(col.l + coeffs[led].amp * sin(coeffs[led].phase + distance), 1), 0);
-            break;
-        default:
-            break;
         }
-        canvas[led] = hsl2rgb(&col);
+        break;
+    }
+    case AM_MOVE_NO_AA:
+        move_leds(distance, 0, canvas);
+        break;
+    case AM_MOVE_AA:
+        move_leds(distance, 1, canvas);
+        break;
+    case AM_SHIMMER:
+        memcpy(canvas, leds, sizeof(ws2811_led_t) * n_leds);
+        shimmer_lightness(canvas, offset);
+        break;
+    case AM_MOVE_SHIMMER:
+        move_leds(distance, 1, canvas);
+        shimmer_lightness(canvas, offset);
+        break;
+    default:
+        break;
     }
 }
 
@@ -340,219 +372,210 @@ int PaintSource_update_leds(int frame, ws2811_t* ledstrip)
     return 1;
 }
 
-//! @brief Take base64 encoded RGB values of LEDs and decode them to the array of HSL colours
+//! @brief Take base64 encoded RGB values of LEDs and decode them to the array of colours
 //! @param payload base64 encoded RGB values
-//! @param target allocated buffer of HSL colours
-static void decode_led_state(char* payload, hsl_t* target)
+//! @param target allocated buffer of colours, the first LED of the chain is the last one in the payload
+static void decode_led_state(char* payload, ws2811_led_t* target)
 {
     unsigned char decoded[MAX_MSG_LENGTH];
     int bytes_decoded = Base64decode(decoded, payload);
     assert(bytes_decoded == 3 * paint_source.basic_source.n_leds);
     for (int led = 0; led < paint_source.basic_source.n_leds; led++)
     {
-        int rgb = decoded[3 * led] << 16 | decoded[3 * led + 1] << 8 | decoded[3 * led + 2];
-        rgb2hsl(rgb, &target[paint_source.basic_source.n_leds - led - 1]);
+        target[paint_source.basic_source.n_leds - led - 1] = decoded[3 * led] << 16 | decoded[3 * led + 1] << 8 | decoded[3 * led + 2];
     }
 }
 
-/* Frame linked list manipulations */
-
-//! @brief Initialize next_frame array to KF_EMPTY_FRAME and head_frame_index to KF_LAST_FRAME
-static void init_frames() 
-{
-    for (int i = 0; i < C_N_KEY_FRAMES; i++) 
-    {
-        next_frame[i] = KF_EMPTY_FRAME;
-    }
-    head_frame_index = KF_LAST_FRAME;
-    current_frame_index = KF_LAST_FRAME;
-}
+/* Key frame list manipulations, positions are 0 based */
 
 static void start_key_frame_animation()
 {
-    current_frame_index = head_frame_index;
-    frame_start = paint_source.basic_source.current_time;
+    Keyframes_start(&key_frames, paint_source.basic_source.current_time);
 }
 
 static void stop_key_frame_animation()
 {
-    current_frame_index = KF_LAST_FRAME;
+    Keyframes_stop(&key_frames);
 }
 
-//! @brief Utitlity function to find an empty key frame
-//! @return index into key_frames where next_frame == KF_EMPTY_FRAME, -1 if no such frame exists
-static int get_empty_frame_index()
+//! @brief Push a new frame to the end of the list
+//! @param encoded_state base64 encoded RGB values
+static void push_frame(char* encoded_state)
 {
-    int new_index = -1;
-    // Find an empty slot in key_frames
-    for (int i = 0; i < C_N_KEY_FRAMES; i++)
+    ws2811_led_t* frame = Keyframes_insert(&key_frames, key_frames.n);
+    if (frame == NULL)
     {
-        if (next_frame[i] == KF_EMPTY_FRAME)
-        {
-            new_index = i;
-            break;
-        }
+        printf("PaintSource: cannot allocate memory for another key frame\n");
+        return;
     }
-    return new_index;
+    decode_led_state(encoded_state, frame);
 }
 
-//! @brief Utility function for getting index to key_frames and next_frame on given position in linked list
-//! @param position in the linked list, 0 based
-//! @return index into key_frames that's position-th in the linked list
-static int get_index_of_position(int position)
+//! @brief Remove a frame from the list
+//! @param index Position in the list that is to be removed
+static void remove_frame(int index)
 {
-    int current = head_frame_index;
-    int cur_position = 0;
-    while (next_frame[current] != KF_LAST_FRAME && cur_position++ < position) current = next_frame[current];
-    if (next_frame[current] == KF_LAST_FRAME && cur_position != position) return -1;
-    return current;
+    Keyframes_remove(&key_frames, index);
 }
 
-//! @brief Push a new frame to the end of the list
+//! @brief Insert a frame at a specific position
+//! @param index Position in the list
 //! @param encoded_state base64 encoded RGB values
-static void push_frame(char* encoded_state) 
+static void insert_frame(int index, char* encoded_state)
 {
-    int new_index = get_empty_frame_index();
-    if (new_index == -1) 
-        return; // No space left
+    ws2811_led_t* frame = Keyframes_insert(&key_frames, index);
+    if (frame == NULL)
+        return; // Invalid position or no memory left
+    decode_led_state(encoded_state, frame);
+}
 
-    // Decode the encoded state into the new frame
-    decode_led_state(encoded_state, key_frames[new_index]);
-    frame_intervals[new_index] = 100;
+//! @brief Swap two frames
+//! @param index1 first position, 0 based
+//! @param index2 second position, 0 based
+static void swap_frames(int index1, int index2)
+{
+    Keyframes_swap(&key_frames, index1, index2);
+}
 
-    // Find the end of the list and add the new frame
-    if (head_frame_index == KF_LAST_FRAME)
-    {
-        head_frame_index = new_index;
-    }
-    else 
-    {
-        int current = head_frame_index;
-        while (next_frame[current] != KF_LAST_FRAME) current = next_frame[current];
-        next_frame[current] = new_index;
-    }
-    next_frame[new_index] = KF_LAST_FRAME;
+static void update_frame(int index, char* encoded_state)
+{
+    ws2811_led_t* frame = Keyframes_frame(&key_frames, index);
+    if (frame == NULL) return;
+    decode_led_state(encoded_state, frame);
 }
 
-//! @brief Remove a frame from the list by index
-//! @param index Position in the linked list that is to be removed
-static void remove_frame(int index) 
+static int update_timing(int index, int timing, keyframe_easing_t easing)
 {
-    if (index < 0 || head_frame_index == KF_LAST_FRAME) 
-        return; // Invalid index or empty list
+    return Keyframes_set_timing(&key_frames, index, timing, easing);
+}
 
-    // Special case: Removing the head of the list
-    if (index == 0) 
-    {
-        int to_remove = head_frame_index;
-        head_frame_index = next_frame[to_remove];
-        next_frame[to_remove] = KF_EMPTY_FRAME; // Mark as empty
-        return;
-    }
+enum EFrameEncoding
+{
+    FE_RAW,     //!< RGB of every LED
+    FE_RLE,     //!< runs of one colour: u8 length - 1, RGB
+    FE_DELTA,   //!< against the previous frame: u8 unchanged LEDs, u8 changed LEDs and RGB of each of them
+    N_FRAME_ENCODINGS
+};
 
-    // Traverse the list to find the node just before the one to remove
-    int current = get_index_of_position(index - 1);
-    if (current < 0) return;
+#define FRAMES_REPLACE 0x01 //!< flag of the upload, all current frames are removed first
 
-    // Remove the target node if it exists
-    int to_remove = next_frame[current];
-    if (to_remove != KF_LAST_FRAME) 
-    {
-        next_frame[current] = next_frame[to_remove];
-        next_frame[to_remove] = KF_EMPTY_FRAME; // Mark as empty
-    }
+static inline uint16_t read_u16(const unsigned char* data)
+{
+    return (uint16_t)(data[0] | data[1] << 8);
 }
 
-//! @brief Insert a frame at a specific position
-//! @param index Position in the linked list
-//! @param encoded_state base64 encoded RGB values
-static void insert_frame(int index, char* encoded_state)
+//! @brief Decode one frame of a bulk upload, LEDs come in the same order as in decode_led_state
+//! @param target NULL only checks the frame
+//! @return number of bytes read, -1 if the data ends early or do not match the number of LEDs
+static int decode_frame(const unsigned char* data, int length, int encoding, const ws2811_led_t* previous, ws2811_led_t* target)
 {
-    if (index < 0 || index >= C_N_KEY_FRAMES)
-        return;
+    int n_leds = paint_source.basic_source.n_leds;
+    int pos = 0;
+    int led = 0;
+    switch (encoding)
+    {
+    case FE_RAW:
+        if (length < 3 * n_leds)
+            return -1;
+        if (target == NULL)
+            return 3 * n_leds;
+        for (; led < n_leds; led++, pos += 3)
+            target[n_leds - led - 1] = data[pos] << 16 | data[pos + 1] << 8 | data[pos + 2];
+        return pos;
+    case FE_RLE:
+        while (led < n_leds)
+        {
+            if (pos + 4 > length || led + data[pos] + 1 > n_leds)
+                return -1;
+            int run = data[pos] + 1;
+            ws2811_led_t color = data[pos + 1] << 16 | data[pos + 2] << 8 | data[pos + 3];
+            for (int i = 0; i < run && target != NULL; i++)
+                target[n_leds - led - i - 1] = color;
+            led += run;
+            pos += 4;
+        }
+        return pos;
+    case FE_DELTA:
+        while (led < n_leds)
+        {
+            if (pos + 2 > length)
+                return -1;
+            int unchanged = data[pos];
+            int changed = data[pos + 1];
+            pos += 2;
+            if (led + unchanged + changed > n_leds || pos + 3 * changed > length || (unchanged == 0 && changed == 0))
+                return -1;
+            if (target == NULL)
+            {
+                led += unchanged + changed;
+                pos += 3 * changed;
+                continue;
+            }
+            for (int i = 0; i < unchanged; i++, led++)
+                target[n_leds - led - 1] = (previous != NULL) ? previous[n_leds - led - 1] : 0;
+            for (int i = 0; i < changed; i++, led++, pos += 3)
+                target[n_leds - led - 1] = data[pos] << 16 | data[pos + 1] << 8 | data[pos + 2];
+        }
+        return pos;
+    default:
+        return -1;
+    }
+}
 
-    int current = 0;
-    // Traverse the linked list to reach the desired position
-    if (index > 0)
+//! @brief Decode many key frames from one message straight into the key frame storage, see PaintSource_process_message.
+//! The whole upload is checked first, an invalid one leaves the current frames untouched
+//! @param payload base64 encoded upload
+//! @return 1 if the frames were added, 0 if the upload was dropped
+static int upload_frames(const char* payload)
+{
+    int n_leds = paint_source.basic_source.n_leds;
+    unsigned char* data = malloc(Base64decode_len(payload));
+    if (data == NULL)
     {
-        current = get_index_of_position(index - 1);
-        if (current < 0) //we are trying to insert outside list length
-            return;
+        printf("PaintSource: cannot allocate memory for key frame upload\n");
+        return 0;
     }
-
-    // Find an empty slot in key_frames for the new frame
-    int new_index = get_empty_frame_index();
-    if (new_index == -1) return; // No space left
-
-    // Decode the encoded state into the new frame at new_index
-    decode_led_state(encoded_state, key_frames[new_index]);
-
-    // Special case: Inserting at the beginning of the list
-    if (index == 0) 
+    int length = Base64decode(data, payload);
+    if (length < 5 || read_u16(data + 3) != n_leds)
     {
-        next_frame[new_index] = head_frame_index;
-        head_frame_index = new_index;
-        return;
+        printf("PaintSource: key frame upload has invalid header\n");
+        free(data);
+        return 0;
     }
-
-    // Insert the new frame into the list at the desired position
-    next_frame[new_index] = next_frame[current];
-    next_frame[current] = new_index;
-}
-
-//! @brief Swap two frames, see also https://www.mycompiler.io/view/5YCknkvWCEr
-//! @param index1 first position, 0 based
-//! @param index2 second position, 0 based
-static void swap_frames(int index1, int index2)
-{
-    if (index1 < 0 || index1 >= C_N_KEY_FRAMES) return;
-    if (index2 < 0 || index2 >= C_N_KEY_FRAMES) return;
-    if (index1 == index2) return;
-    if (index1 > index2)
-    {
-        int i = index2;
-        index2 = index1;
-        index1 = i;
-    }
-    int kf_index2 = get_index_of_position(index2);
-    int kf_index2_prev = get_index_of_position(index2 - 1);
-    if (kf_index2 < 0 || kf_index2_prev < 0) return;
-    if (index1 == 0)
-    {
-        int tmp = next_frame[kf_index2];
-        next_frame[kf_index2_prev] = head_frame_index;
-        next_frame[kf_index2] = next_frame[head_frame_index];
-        next_frame[head_frame_index] = tmp;
-        head_frame_index = kf_index2;
+    int n_frames = read_u16(data + 1);
+    int pos = 5;
+    for (int frame = 0; frame < n_frames; frame++)
+    {
+        int valid = pos + 4 <= length && data[pos + 2] < N_KEYFRAME_EASINGS;
+        int read = valid ? decode_frame(data + pos + 4, length - pos - 4, data[pos + 3], NULL, NULL) : -1;
+        if (read < 0)
+        {
+            printf("PaintSource: key frame %i of the upload is invalid, the upload is dropped\n", frame);
+            free(data);
+            return 0;
+        }
+        pos += 4 + read;
     }
-    else
+    int first = (data[0] & FRAMES_REPLACE) ? 0 : key_frames.n;
+    if (!Keyframes_reserve(&key_frames, first + n_frames))
     {
-        int kf_index1 = get_index_of_position(index1);
-        int kf_index1_prev = get_index_of_position(index1 - 1);
-        if (kf_index1 < 0 || kf_index1_prev < 0) return;
-
-        next_frame[kf_index1_prev] = kf_index2;
-        next_frame[kf_index2_prev] = kf_index1;
-        int tmp = next_frame[kf_index2];
-        next_frame[kf_index2] = next_frame[kf_index1];
-        next_frame[kf_index1] = tmp;
+        printf("PaintSource: cannot allocate memory for %i key frames\n", n_frames);
+        free(data);
+        return 0;
     }
-}
-
-static void update_frame(int index, char* encoded_state)
-{
-    if (index < 0 || index > C_N_KEY_FRAMES) return;
-    int kf_index = get_index_of_position(index);
-    if (kf_index < 0) return;
-    decode_led_state(encoded_state, key_frames[kf_index]);
-}
-
-static void update_timing(int index, int timing)
-{
-    if (index < 0 || index > C_N_KEY_FRAMES) return;
-    int kf_index = get_index_of_position(index);
-    if (kf_index < 0) return;
-    frame_intervals[kf_index] = timing;
+    if (data[0] & FRAMES_REPLACE)
+        Keyframes_clear(&key_frames);
+    pos = 5;
+    for (int frame = 0; frame < n_frames; frame++)
+    {
+        ws2811_led_t* target = Keyframes_insert(&key_frames, key_frames.n);
+        const ws2811_led_t* previous = Keyframes_frame(&key_frames, key_frames.n - 2);
+        int read = decode_frame(data + pos + 4, length - pos - 4, data[pos + 3], previous, target);
+        Keyframes_set_timing(&key_frames, key_frames.n - 1, read_u16(data + pos), (keyframe_easing_t)data[pos + 2]);
+        pos += 4 + read;
+    }
+    free(data);
+    return 1;
 }
 
 
@@ -564,9 +587,15 @@ static void update_timing(int index, int timing)
 //!     anim?<mode>=<speed>
 //!     add?<base64 encoded RGB values>
 //!     del?<int position in linked list>
+//!     insert?<pos>&<base 64 encoded>
 //!     update?<pos>&<base 64 encoded>
-//!     time?<pos>&<int timing>
+//!     time?<pos>&<int timing>[&<easing>], easing is keyframe_easing_t, linear when omitted
 //!     swap?<pos1>&<pos2>
+//!     frames?<base64 encoded upload>
+//! The upload carries many key frames at once, all numbers are little endian:
+//!     header: u8 flags (FRAMES_REPLACE), u16 number of frames, u16 number of LEDs
+//!     frame:  u16 interval in ms, u8 easing, u8 encoding (EFrameEncoding), encoded colours
+//! It is not limited by MAX_MSG_LENGTH, a few hundred frames are decoded in one go
 //! @param msg 
 void PaintSource_process_message(const char* msg)
 {
@@ -581,6 +610,12 @@ void PaintSource_process_message(const char* msg)
         printf("PaintSource: target is too long or poorly formatted: %s\n", msg);
         return;
     }
+    if ((sep - msg) == 6 && !strncasecmp(msg, "frames", 6))
+    {
+        if (upload_frames(sep + 1))
+            start_key_frame_animation();
+        return;
+    }
     if ((strlen(sep + 1) >= MAX_MSG_LENGTH))
     {
         printf("PaintSource: message too long or poorly formatted: %s\n", msg);
@@ -635,6 +670,20 @@ void PaintSource_process_message(const char* msg)
         start_key_frame_animation();
         return;
     }
+    if (!strncasecmp(target, "insert", 6))
+    {
+        char encoded[MAX_MSG_LENGTH];
+        int index;
+        int n = sscanf(payload, "%i&%s", &index, encoded);
+        if (n != 2)
+        {
+            printf("Keyframe insert message invalid format\n");
+            return;
+        }
+        insert_frame(index, encoded);
+        start_key_frame_animation();
+        return;
+    }
     if (!strncasecmp(target, "update", 6))
     {
         char encoded[MAX_MSG_LENGTH];
@@ -653,13 +702,18 @@ void PaintSource_process_message(const char* msg)
     {
         int index;
         int timing;
-        int n = sscanf(payload, "%i&%i", &index, &timing);
-        if (n != 2)
+        int easing = KE_LINEAR;
+        int n = sscanf(payload, "%i&%i&%i", &index, &timing, &easing);
+        if (n < 2)
         {
             printf("Keyframe timing message invalid format\n");
             return;
         }
-        update_timing(index, timing);
+        if (!update_timing(index, timing, (keyframe_easing_t)easing))
+        {
+            printf("PaintSource: invalid key frame %i or easing %i in timing message\n", index, easing);
+            return;
+        }
         start_key_frame_animation();
         return;
     }
@@ -700,25 +754,23 @@ static void hint_mc_init()
 void PaintSource_init(int n_leds, int time_speed, uint64_t current_time)
 {
     BasicSource_init(&paint_source.basic_source, n_leds, time_speed, source_config.colors[PAINT_SOURCE], current_time);
-    leds = malloc(n_leds * sizeof(hsl_t));
-    for (int led = 0; led < n_leds; led++)
+    leds = calloc(n_leds, sizeof(ws2811_led_t));
+    if (!Keyframes_init(&key_frames, n_leds, C_N_KEY_FRAMES))
     {
-        rgb2hsl(0, &leds[led]);
+        printf("Cannot allocate memory for key frames\n");
+        exit(-4);
     }
-    for (int frame = 0; frame < C_N_KEY_FRAMES; frame++)
+    canvas = malloc(n_leds * sizeof(ws2811_led_t));
+    moved = malloc((n_leds + 1) * sizeof(ws2811_led_t));
+    shimmer_amp = calloc(n_leds, sizeof(int16_t));
+    shimmer_phase = calloc(n_leds, sizeof(uint16_t));
+    for (int i = 0; i < SHIMMER_LUT_LEN; i++)
     {
-        key_frames[frame] = malloc(n_leds * sizeof(hsl_t));
-        for (int led = 0; led < n_leds; led++)
-        {
-            rgb2hsl(0, &key_frames[frame][led]);
-        }
+        sin_lut[i] = (int16_t)lround(32767 * sin(2 * M_PI * i / SHIMMER_LUT_LEN));
     }
-    canvas = malloc(n_leds * sizeof(int));
-    coeffs = malloc(n_leds * sizeof(AmpPhase_t));
     paint_source.start_time = current_time;
     animation_start = current_time;
     hint_mc_init();
-    init_frames();
 
     //switch_animation_mode(AM_MOVE_SHIMMER, 1.1);
     //show_secret();
@@ -727,9 +779,11 @@ void PaintSource_init(int n_leds, int time_speed, uint64_t current_time)
 void PaintSource_destruct(void)
 {
     free(leds);
-    for (int frame = 0; frame < C_N_KEY_FRAMES; frame++) free(key_frames[frame]);
+    Keyframes_free(&key_frames);
     free(canvas);
-    free(coeffs);
+    free(moved);
+    free(shimmer_amp);
+    free(shimmer_phase);
 }
 
 void PaintSource_construct(void)
@@ -0,0 +1,213 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include "ws2811.h"
+#else
+#include "fakeled.h"
+#endif // __linux__
+
+#include "common_source.h"
+#include "geometry.h"
+#include "particles.h"
+
+int Particles_init(particles_t* particles, int capacity)
+{
+    memset(particles, 0, sizeof(*particles));
+    particles->capacity = capacity;
+    particles->origin = malloc(sizeof(int16_t) * capacity);
+    particles->next_stop = malloc(sizeof(int16_t) * capacity);
+    particles->destination = malloc(sizeof(int16_t) * capacity);
+    particles->home = malloc(sizeof(int16_t) * capacity);
+    particles->direction = malloc(sizeof(uint8_t) * capacity);
+    particles->is_alive = malloc(sizeof(uint8_t) * capacity);
+    particles->is_moving = malloc(sizeof(uint8_t) * capacity);
+    particles->stop_at_destination = malloc(sizeof(uint8_t) * capacity);
+    particles->respawn = malloc(sizeof(uint8_t) * capacity);
+    particles->distance = malloc(sizeof(float) * capacity);
+    particles->speed = malloc(sizeof(float) * capacity);
+    particles->acceleration = malloc(sizeof(float) * capacity);
+    particles->move_chance = malloc(sizeof(float) * capacity);
+    particles->behind = malloc(sizeof(float) * capacity);
+    particles->ahead = malloc(sizeof(float) * capacity);
+    particles->behind_ramp = malloc(sizeof(particle_ramp_t) * capacity);
+    particles->ahead_ramp = malloc(sizeof(particle_ramp_t) * capacity);
+    particles->blend = malloc(sizeof(uint8_t) * capacity);
+    if (!particles->origin || !particles->next_stop || !particles->destination || !particles->home ||
+        !particles->direction || !particles->is_alive || !particles->is_moving || !particles->stop_at_destination ||
+        !particles->respawn || !particles->distance || !particles->speed || !particles->acceleration ||
+        !particles->move_chance || !particles->behind || !particles->ahead || !particles->behind_ramp ||
+        !particles->ahead_ramp || !particles->blend)
+    {
+        Particles_free(particles);
+        return 0;
+    }
+    return 1;
+}
+
+void Particles_free(particles_t* particles)
+{
+    free(particles->origin);
+    free(particles->next_stop);
+    free(particles->destination);
+    free(particles->home);
+    free(particles->direction);
+    free(particles->is_alive);
+    free(particles->is_moving);
+    free(particles->stop_at_destination);
+    free(particles->respawn);
+    free(particles->distance);
+    free(particles->speed);
+    free(particles->acceleration);
+    free(particles->move_chance);
+    free(particles->behind);
+    free(particles->ahead);
+    free(particles->behind_ramp);
+    free(particles->ahead_ramp);
+    free(particles->blend);
+    memset(particles, 0, sizeof(*particles));
+}
+
+void Particles_clear(particles_t* particles)
+{
+    particles->n = 0;
+}
+
+int Particles_add(particles_t* particles, int origin, dir_t direction, float speed)
+{
+    if (particles->n == particles->capacity)
+        return -1;
+    int p = particles->n++;
+    particles->origin[p] = origin;
+    particles->next_stop[p] = -1;
+    particles->destination[p] = -1;
+    particles->home[p] = origin;
+    particles->direction[p] = direction;
+    particles->is_alive[p] = 1;
+    particles->is_moving[p] = 1;
+    particles->stop_at_destination[p] = 0;
+    particles->respawn[p] = 0;
+    particles->distance[p] = 0;
+    particles->speed[p] = speed;
+    particles->acceleration[p] = 0;
+    particles->move_chance[p] = 1;
+    particles->behind[p] = 0;
+    particles->ahead[p] = 0;
+    particles->behind_ramp[p].colors = NULL;
+    particles->ahead_ramp[p].colors = NULL;
+    particles->blend[p] = PB_REPLACE;
+    return p;
+}
+
+void Particles_update(particles_t* particles, const geometry_t* geometry, uint64_t time_delta)
+{
+    double time_seconds = (time_delta / (long)1e3) / (double)1e6;
+    double accel_seconds = (double)time_delta / (double)1e9;
+    int16_t (*neighbor)[N_DIRS] = geometry->neighbor;
+    for (int p = 0; p < particles->n; ++p)
+    {
+        if (!particles->is_alive[p] || !particles->is_moving[p])
+            continue;
+        if (particles->move_chance[p] < 1.0f && random_01() >= particles->move_chance[p])
+            continue;
+        particles->speed[p] += particles->acceleration[p] * (float)accel_seconds;
+        particles->distance[p] += particles->speed[p] * (float)time_seconds;
+        if (particles->distance[p] >= 1.0f)
+        {
+            particles->distance[p] -= 1;
+            if (particles->distance[p] > 1.0f) //this should never happen, it means that we have travelled more than one led distance in one frame
+            {
+                particles->distance[p] = 0.9f;
+            }
+            int origin = neighbor[particles->origin[p]][particles->direction[p]];
+            particles->origin[p] = origin;
+            if ((neighbor[origin][particles->direction[p]] == -1) // we cannot keep moving in this direction
+                || (particles->destination[p] == origin && particles->stop_at_destination[p]))  // or we are supposed to stop at destination and we have arrived
+            {
+                particles->distance[p] = 0.0f;
+                if (particles->respawn[p])
+                    particles->origin[p] = particles->home[p];
+                else
+                    particles->is_moving[p] = 0;
+            }
+        }
+        particles->next_stop[p] = neighbor[particles->origin[p]][particles->direction[p]];
+    }
+}
+
+static inline ws2811_led_t ramp_color(const particle_ramp_t* ramp, float u)
+{
+    int i = (int)(u * (ramp->steps - 1) + 0.5f);
+    if (i < 0) i = 0;
+    if (i >= ramp->steps) i = ramp->steps - 1;
+    return ramp->colors[i];
+}
+
+static inline void blend_led(ws2811_led_t* led, ws2811_led_t color, particle_blend_t blend)
+{
+    switch (blend)
+    {
+    case PB_REPLACE:
+        *led = color;
+        break;
+    case PB_MAX:
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            if (((color >> shift) & 0xFF) > ((*led >> shift) & 0xFF))
+                *led = (*led & ~(0xFF << shift)) | (color & (0xFF << shift));
+        }
+        break;
+    case PB_ADD:
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            int c = ((*led >> shift) & 0xFF) + ((color >> shift) & 0xFF);
+            *led = (*led & ~(0xFF << shift)) | ((c > 0xFF ? 0xFF : c) << shift);
+        }
+        break;
+    }
+}
+
+/*! Direction against `dir`, the compass turns around, forward and backward swap */
+static inline dir_t opposite(dir_t dir)
+{
+    return (dir < N_COMPASS_DIRS) ? (dir_t)((dir + 2) % N_COMPASS_DIRS) : (dir_t)(dir ^ 1);
+}
+
+void Particles_render(const particles_t* particles, const geometry_t* geometry, ws2811_led_t* leds)
+{
+    int16_t (*neighbor)[N_DIRS] = geometry->neighbor;
+    for (int p = 0; p < particles->n; ++p)
+    {
+        if (!particles->is_alive[p])
+            continue;
+        float t = particles->distance[p];
+        dir_t dir = (dir_t)particles->direction[p];
+        particle_blend_t blend = (particle_blend_t)particles->blend[p];
+        //the origin is t behind the particle, the k-th LED behind it is k + t behind
+        if (particles->behind_ramp[p].colors != NULL)
+        {
+            float behind = particles->behind[p];
+            dir_t back = opposite(dir);
+            int led = particles->origin[p];
+            for (int k = 0; led != -1 && k + t < behind; ++k)
+            {
+                blend_led(&leds[led], ramp_color(&particles->behind_ramp[p], 1.0f - (k + t) / behind), blend);
+                led = neighbor[led][back];
+            }
+        }
+        //the k-th LED from the origin in the direction of movement is k - t ahead
+        if (particles->ahead_ramp[p].colors != NULL)
+        {
+            float ahead = particles->ahead[p];
+            int led = neighbor[particles->origin[p]][dir];
+            for (int k = 1; led != -1 && k - t < ahead; ++k)
+            {
+                blend_led(&leds[led], ramp_color(&particles->ahead_ramp[p], 1.0f - (k - t) / ahead), blend);
+                led = neighbor[led][dir];
+            }
+        }
+    }
+}
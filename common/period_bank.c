@@ -0,0 +1,148 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include "ws2811.h"
+#else
+#include "fakeled.h"
+#endif // __linux__
+
+#include "common_source.h"
+#include "period_bank.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PERIOD_NEON
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PERIOD_SSE
+#endif
+
+/* sin(pi / 2 * v) for v in <-1; 1> is v * (C1 + v^2 * (C3 + v^2 * (C5 + v^2 * (C7 + v^2 * C9)))), Taylor series,
+ * the error is below 1e-5 which is way below what 8 bits of a LED can show */
+#define C1   1.5707963268f
+#define C3  -0.6459640975f
+#define C5   0.0796926262f
+#define C7  -0.0046817541f
+#define C9   0.0001604411f
+
+/*! Roll the next period, it starts where the last one ended, i.e. `overshoot` ms ago */
+static void roll_period(period_bank_t* bank, int i, float overshoot)
+{
+    long length = (long)bank->base_period + (long)((random_01() - 0.5f) * bank->period_range);
+    if (length < 1)
+        length = 1;
+    float total = overshoot + (float)length;
+    bank->phase[i] = overshoot / total;
+    bank->step[i] = 1.0f / total;
+}
+
+int PeriodBank_init(period_bank_t* bank, int n, unsigned long base_period, unsigned long period_range, const double* shift)
+{
+    bank->n = n;
+    bank->base_period = base_period;
+    bank->period_range = period_range;
+    bank->phase = malloc(sizeof(float) * n);
+    bank->step = malloc(sizeof(float) * n);
+    bank->shift = malloc(sizeof(float) * n);
+    if (!bank->phase || !bank->step || !bank->shift)
+    {
+        PeriodBank_free(bank);
+        return 0;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        roll_period(bank, i, 0);
+        double turns = (shift != NULL) ? shift[i] / (2 * M_PI) : 0;
+        turns -= (double)(long)turns;
+        bank->shift[i] = (float)((turns < 0) ? turns + 1 : turns);
+    }
+    return 1;
+}
+
+void PeriodBank_advance(period_bank_t* bank, uint64_t time_delta)
+{
+    float ms = (float)time_delta / 1e6f;
+    for (int i = 0; i < bank->n; ++i)
+    {
+        float phase = bank->phase[i] + bank->step[i] * ms;
+        if (phase >= 1.0f)
+            roll_period(bank, i, (phase - 1.0f) / bank->step[i]);
+        else
+            bank->phase[i] = phase;
+    }
+}
+
+/*! cos(2 * pi * x) for x in <0; 2), cos is -sin(pi / 2 * (1 - 4 * |x' - 0.5|)) with x' being the fractional part of x */
+static inline float cos_turns(float x)
+{
+    x -= (float)(int)x;
+    float d = x - 0.5f;
+    float v = 1.0f - 4.0f * ((d < 0) ? -d : d);
+    float v2 = v * v;
+    return -v * (C1 + v2 * (C3 + v2 * (C5 + v2 * (C7 + v2 * C9))));
+}
+
+void PeriodBank_cos(const period_bank_t* bank, float add, float mul, float* out)
+{
+    int i = 0;
+#if defined(PERIOD_NEON)
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t four = vdupq_n_f32(4.0f);
+    const float32x4_t vadd = vdupq_n_f32(add);
+    const float32x4_t vmul = vdupq_n_f32(-mul); //the sign of the cosine goes here
+    for (; i + 4 <= bank->n; i += 4)
+    {
+        float32x4_t x = vaddq_f32(vld1q_f32(bank->phase + i), vld1q_f32(bank->shift + i));
+        x = vsubq_f32(x, vcvtq_f32_s32(vcvtq_s32_f32(x)));
+        float32x4_t v = vmlsq_f32(one, four, vabsq_f32(vsubq_f32(x, half)));
+        float32x4_t v2 = vmulq_f32(v, v);
+        float32x4_t p = vmlaq_f32(vdupq_n_f32(C7), v2, vdupq_n_f32(C9));
+        p = vmlaq_f32(vdupq_n_f32(C5), v2, p);
+        p = vmlaq_f32(vdupq_n_f32(C3), v2, p);
+        p = vmlaq_f32(vdupq_n_f32(C1), v2, p);
+        vst1q_f32(out + i, vmlaq_f32(vadd, vmul, vmulq_f32(v, p)));
+    }
+#elif defined(PERIOD_SSE)
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 four = _mm_set1_ps(4.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 vadd = _mm_set1_ps(add);
+    const __m128 vmul = _mm_set1_ps(-mul); //the sign of the cosine goes here
+    for (; i + 4 <= bank->n; i += 4)
+    {
+        __m128 x = _mm_add_ps(_mm_loadu_ps(bank->phase + i), _mm_loadu_ps(bank->shift + i));
+        x = _mm_sub_ps(x, _mm_cvtepi32_ps(_mm_cvttps_epi32(x)));
+        __m128 v = _mm_sub_ps(one, _mm_mul_ps(four, _mm_andnot_ps(sign, _mm_sub_ps(x, half))));
+        __m128 v2 = _mm_mul_ps(v, v);
+        __m128 p = _mm_add_ps(_mm_set1_ps(C7), _mm_mul_ps(v2, _mm_set1_ps(C9)));
+        p = _mm_add_ps(_mm_set1_ps(C5), _mm_mul_ps(v2, p));
+        p = _mm_add_ps(_mm_set1_ps(C3), _mm_mul_ps(v2, p));
+        p = _mm_add_ps(_mm_set1_ps(C1), _mm_mul_ps(v2, p));
+        _mm_storeu_ps(out + i, _mm_add_ps(vadd, _mm_mul_ps(vmul, _mm_mul_ps(v, p))));
+    }
+#endif
+    for (; i < bank->n; ++i)
+    {
+        out[i] = add + mul * cos_turns(bank->phase[i] + bank->shift[i]);
+    }
+}
+
+float PeriodBank_turns(const period_bank_t* bank, int i)
+{
+    float x = bank->phase[i] + bank->shift[i];
+    return x - (float)(int)x;
+}
+
+void PeriodBank_free(period_bank_t* bank)
+{
+    free(bank->phase);
+    free(bank->step);
+    free(bank->shift);
+    memset(bank, 0, sizeof(*bank));
+}
@@ -13,6 +13,8 @@
 #include "common_source.h"
 #include "perlin_source.h"
 #include "colours.h"
+#include "audio_analysis.h"
+#include "led_main.h"
 
 
 static void PerlinSource_build_noise()
@@ -20,10 +22,12 @@ static void PerlinSource_build_noise()
     for (int f = 0; f < PERLIN_FREQ_N; ++f)
     {
         perlin_source.noise[f] = (struct noise_t*)malloc(sizeof(struct noise_t) * 100); // perlin_source.noise_freq[f]);
+        float r01[2 * 100];
+        random_01_n(r01, 2 * perlin_source.noise_freq[f]);
         for (int i = 0; i < perlin_source.noise_freq[f]; ++i)
         {
-            perlin_source.noise[f][i].amplitude = 2.0f * random_01() - 1.0f;
-            perlin_source.noise[f][i].phase = 2.0f * random_01() * (float)M_PI;
+            perlin_source.noise[f][i].amplitude = 2.0f * r01[2 * i] - 1.0f;
+            perlin_source.noise[f][i].phase = 2.0f * r01[2 * i + 1] * (float)M_PI;
         }
     }
 }
@@ -64,16 +68,37 @@ static int PerlinSource_get_gradient_index(int led, int frame)
 
 int PerlinSource_update_leds(int frame, ws2811_t* ledstrip)
 {
+    double brightness = 1.0;
+    if (perlin_source.audio_reactive)
+    {
+        audio_features_t features;
+        AudioAnalysis_get_features(&features);
+        if (!features.is_silent)
+            brightness = 0.5 + 0.5 * features.beat_phase;
+    }
     for (int led = 0; led < perlin_source.basic_source.n_leds; ++led)
     {
         int y = PerlinSource_get_gradient_index(led, frame);
-        ledstrip->channel[0].leds[led] = perlin_source.basic_source.gradient.colors[y];
+        ws2811_led_t color = perlin_source.basic_source.gradient.colors[y];
+        ledstrip->channel[0].leds[led] = (brightness < 1.0) ? multiply_rgb_color(color, brightness) : color;
     }
     return 1;
 }
 
+int PerlinSource_process_config(const char* name, const char* value)
+{
+    if (strcasecmp(name, "audio_reactive") == 0) {
+        perlin_source.audio_reactive = atoi(value);
+        return 1;
+    }
+    printf("Unknown config option %s with value %s\n", name, value);
+    return 0;
+}
+
 void PerlinSource_destruct()
 {
+    if (perlin_source.audio_reactive)
+        AudioAnalysis_stop();
     for (int f = 0; f < PERLIN_FREQ_N; ++f)
     {
         free(perlin_source.noise[f]);
@@ -84,6 +109,8 @@ void PerlinSource_init(int n_leds, int time_speed, uint64_t current_time)
 {
     BasicSource_init(&perlin_source.basic_source, n_leds, time_speed, source_config.colors[PERLIN_SOURCE], current_time);
     PerlinSource_build_noise();
+    if (perlin_source.audio_reactive)
+        AudioAnalysis_start(arg_options.frame_time, arg_options.audio_file);
 }
 
 void PerlinSource_construct()
@@ -92,6 +119,7 @@ void PerlinSource_construct()
     perlin_source.basic_source.init = PerlinSource_init;
     perlin_source.basic_source.update = PerlinSource_update_leds;
     perlin_source.basic_source.destruct = PerlinSource_destruct;
+    perlin_source.basic_source.process_config = PerlinSource_process_config;
 }
 
 PerlinSource perlin_source =
@@ -0,0 +1,409 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "controller.h"
+#include "replay.h"
+
+#define REPLAY_MAGIC        "LEDR"
+#define REPLAY_VERSION      1
+
+enum ReplayTags
+{
+    RT_FRAME    = 'F',  //!< time delta of the frame minus frame time, zigzag
+    RT_BUTTON   = 'B',  //!< player, call of the player in the frame, button, state
+    RT_PLAYERS  = 'N',  //!< number of controllers found by `Controller_init`
+    RT_MESSAGE  = 'M',  //!< length and the text
+    RT_SOUND    = 'S'   //!< song position, zigzag
+};
+
+struct ButtonEvent
+{
+    int player;
+    int call;
+    int button;
+    int state;
+    int is_used;
+};
+
+struct RecordedMessage
+{
+    const uint8_t* text;            //!< in `data`, not terminated
+    size_t length;
+};
+
+/*! Inputs of one frame, recorded ones in playback, each kind is consumed in the order it was recorded */
+struct FrameInputs
+{
+    struct ButtonEvent* buttons;
+    int n_buttons;
+    int capacity_buttons;
+    struct RecordedMessage* messages;
+    int n_messages;
+    int capacity_messages;
+    long* sounds;
+    int n_sounds;
+    int capacity_sounds;
+    int players[C_MAX_CONTROLLERS];
+    int n_players;
+    //consumed so far
+    int read_messages;
+    int read_sounds;
+    int read_players;
+};
+
+static enum ReplayMode mode = RM_OFF;
+static FILE* file;
+static uint8_t* data;           //!< whole recording in playback
+static size_t data_length;
+static size_t position;
+static uint64_t frame_time_ns;
+static long frame;
+static int calls[C_MAX_CONTROLLERS];
+static struct FrameInputs inputs;
+static int n_desyncs;
+static long n_bytes;
+
+static void* reserve(void* items, int* capacity, int needed, size_t item_size)
+{
+    if (needed <= *capacity)
+        return items;
+    int new_capacity = (*capacity > 0) ? *capacity * 2 : 16;
+    items = realloc(items, new_capacity * item_size);
+    if (items == NULL)
+    {
+        fprintf(stderr, "Out of memory for replay\n");
+        exit(-4);
+    }
+    *capacity = new_capacity;
+    return items;
+}
+
+static void report_desync(const char* what)
+{
+    if (++n_desyncs > REPLAY_MAX_REPORTED)
+        return;
+    printf("Frame %li: replay diverged, %s\n", frame, what);
+}
+
+//recording
+
+static void write_uint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc((int)(value & 0x7F) | 0x80, file);
+        value >>= 7;
+        n_bytes++;
+    }
+    fputc((int)value, file);
+    n_bytes++;
+}
+
+static void write_int(int64_t value)
+{
+    write_uint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void Replay_start_recording(const char* filename, const replay_header_t* header)
+{
+    file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot open replay file %s\n", filename);
+        exit(1);
+    }
+    fwrite(REPLAY_MAGIC, 1, 4, file);
+    n_bytes = 4;
+    write_uint(REPLAY_VERSION);
+    write_uint(header->seed);
+    write_uint(header->source_type);
+    write_uint(header->led_count);
+    write_uint(header->time_speed);
+    write_uint(header->frame_time);
+    write_uint(header->start_ns);
+    frame_time_ns = header->frame_time * 1000;
+    frame = 0;
+    memset(calls, 0, sizeof(calls));
+    mode = RM_RECORD;
+}
+
+void Replay_write_frame(uint64_t time_delta)
+{
+    if (++frame % REPLAY_FLUSH_FRAMES == 0)
+        fflush(file);
+    fputc(RT_FRAME, file);
+    n_bytes++;
+    write_int((int64_t)(time_delta - frame_time_ns));
+    memset(calls, 0, sizeof(calls));
+}
+
+void Replay_write_button(int player, int result, int button, int state)
+{
+    assert(player < C_MAX_CONTROLLERS);
+    int call = calls[player]++;
+    if (result <= 0)
+        return;
+    fputc(RT_BUTTON, file);
+    n_bytes++;
+    write_uint(player);
+    write_uint(call);
+    write_uint(button);
+    write_uint(state);
+}
+
+void Replay_write_players(int n_players)
+{
+    fputc(RT_PLAYERS, file);
+    n_bytes++;
+    write_uint(n_players);
+}
+
+void Replay_write_message(const char* msg)
+{
+    if (msg == NULL)
+        return;
+    size_t length = strlen(msg);
+    fputc(RT_MESSAGE, file);
+    n_bytes++;
+    write_uint(length);
+    fwrite(msg, 1, length, file);
+    n_bytes += (long)length;
+}
+
+void Replay_write_sound(long position)
+{
+    fputc(RT_SOUND, file);
+    n_bytes++;
+    write_int(position);
+}
+
+//playback
+
+static uint64_t read_uint()
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (position >= data_length)
+            break;
+        uint8_t byte = data[position++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    fprintf(stderr, "Replay file is truncated or corrupted at byte %zu\n", position);
+    exit(1);
+}
+
+static int64_t read_int()
+{
+    uint64_t value = read_uint();
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/*! @brief Check that the last frame used all its inputs and read the inputs of the next one, up to its frame tag */
+static void load_frame_inputs()
+{
+    for (int b = 0; b < inputs.n_buttons; ++b)
+    {
+        if (!inputs.buttons[b].is_used)
+            report_desync("recorded button was not read");
+    }
+    if (inputs.read_messages < inputs.n_messages)
+        report_desync("recorded message was not read");
+    if (inputs.read_sounds < inputs.n_sounds)
+        report_desync("recorded sound position was not read");
+    if (inputs.read_players < inputs.n_players)
+        report_desync("controllers were not initialized");
+    inputs.n_buttons = inputs.n_messages = inputs.n_sounds = inputs.n_players = 0;
+    inputs.read_messages = inputs.read_sounds = inputs.read_players = 0;
+    memset(calls, 0, sizeof(calls));
+
+    while (position < data_length && data[position] != RT_FRAME)
+    {
+        switch (data[position++])
+        {
+        case RT_BUTTON:
+        {
+            inputs.buttons = reserve(inputs.buttons, &inputs.capacity_buttons, inputs.n_buttons + 1, sizeof(struct ButtonEvent));
+            struct ButtonEvent* event = &inputs.buttons[inputs.n_buttons++];
+            event->player = (int)read_uint();
+            event->call = (int)read_uint();
+            event->button = (int)read_uint();
+            event->state = (int)read_uint();
+            event->is_used = 0;
+            break;
+        }
+        case RT_PLAYERS:
+        {
+            int n_players = (int)read_uint();
+            if (inputs.n_players < C_MAX_CONTROLLERS)
+                inputs.players[inputs.n_players++] = n_players;
+            break;
+        }
+        case RT_MESSAGE:
+        {
+            inputs.messages = reserve(inputs.messages, &inputs.capacity_messages, inputs.n_messages + 1, sizeof(struct RecordedMessage));
+            struct RecordedMessage* message = &inputs.messages[inputs.n_messages++];
+            message->length = (size_t)read_uint();
+            if (message->length > data_length - position)
+            {
+                fprintf(stderr, "Replay file is truncated in a message\n");
+                exit(1);
+            }
+            message->text = data + position;
+            position += message->length;
+            break;
+        }
+        case RT_SOUND:
+            inputs.sounds = reserve(inputs.sounds, &inputs.capacity_sounds, inputs.n_sounds + 1, sizeof(long));
+            inputs.sounds[inputs.n_sounds++] = (long)read_int();
+            break;
+        default:
+            fprintf(stderr, "Unknown record %02x in replay file at byte %zu\n", data[position - 1], position - 1);
+            exit(1);
+        }
+    }
+}
+
+void Replay_start_playback(const char* filename, replay_header_t* header)
+{
+    file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot open replay file %s\n", filename);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    data_length = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = malloc(data_length + 1);
+    if (data == NULL || fread(data, 1, data_length, file) != data_length)
+    {
+        fprintf(stderr, "cannot read replay file %s\n", filename);
+        exit(1);
+    }
+    fclose(file);
+    file = NULL;
+    if (data_length < 4 || memcmp(data, REPLAY_MAGIC, 4))
+    {
+        fprintf(stderr, "%s is not a replay file\n", filename);
+        exit(1);
+    }
+    position = 4;
+    int version = (int)read_uint();
+    if (version != REPLAY_VERSION)
+    {
+        fprintf(stderr, "Replay file version %i is not supported\n", version);
+        exit(1);
+    }
+    header->seed = (uint32_t)read_uint();
+    header->source_type = (int)read_uint();
+    header->led_count = (int)read_uint();
+    header->time_speed = (int)read_uint();
+    header->frame_time = read_uint();
+    header->start_ns = read_uint();
+    frame_time_ns = header->frame_time * 1000;
+    frame = 0;
+    n_desyncs = 0;
+    mode = RM_PLAY;
+    //inputs read during the init of the source, before the first frame
+    load_frame_inputs();
+}
+
+enum ReplayMode Replay_get_mode()
+{
+    return mode;
+}
+
+int Replay_next_frame(uint64_t* time_delta)
+{
+    if (position >= data_length)
+        return 0;
+    assert(data[position] == RT_FRAME);
+    position++;
+    *time_delta = frame_time_ns + (uint64_t)read_int();
+    frame++;
+    load_frame_inputs();
+    return 1;
+}
+
+int Replay_read_button(int player, int* button, int* state)
+{
+    assert(player < C_MAX_CONTROLLERS);
+    int call = calls[player]++;
+    for (int b = 0; b < inputs.n_buttons; ++b)
+    {
+        struct ButtonEvent* event = &inputs.buttons[b];
+        if (event->player == player && event->call == call)
+        {
+            event->is_used = 1;
+            *button = event->button;
+            *state = event->state;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int Replay_read_players()
+{
+    if (inputs.read_players == inputs.n_players)
+    {
+        report_desync("controllers were initialized more times than recorded");
+        return 0;
+    }
+    return inputs.players[inputs.read_players++];
+}
+
+char* Replay_read_message()
+{
+    if (inputs.read_messages == inputs.n_messages)
+        return NULL;
+    const struct RecordedMessage* message = &inputs.messages[inputs.read_messages++];
+    char* msg = malloc(message->length + 1);
+    if (msg != NULL)
+    {
+        memcpy(msg, message->text, message->length);
+        msg[message->length] = 0x0;
+    }
+    return msg;
+}
+
+long Replay_read_sound()
+{
+    if (inputs.read_sounds == inputs.n_sounds)
+    {
+        report_desync("song position was asked for more times than recorded");
+        return -1;
+    }
+    return inputs.sounds[inputs.read_sounds++];
+}
+
+int Replay_finish()
+{
+    if (mode == RM_RECORD)
+    {
+        fclose(file);
+        file = NULL;
+        printf("Recorded %li frames in %li bytes\n", frame, n_bytes);
+    }
+    else if (mode == RM_PLAY)
+    {
+        load_frame_inputs();
+        free(data);
+        free(inputs.buttons);
+        free(inputs.messages);
+        free(inputs.sounds);
+        memset(&inputs, 0, sizeof(inputs));
+        data = NULL;
+        printf("Replayed %li frames, %i inputs diverged\n", frame, n_desyncs);
+    }
+    mode = RM_OFF;
+    return n_desyncs;
+}
@@ -79,6 +79,7 @@ static enum SourceType active_source = N_SOURCE_TYPES;
 struct LedParam {
     int led_count;
     int time_speed;
+    uint32_t seed;
 };
 static struct LedParam led_param;
 static void read_config();
@@ -99,13 +100,17 @@ static void set_source(enum SourceType source_type, uint64_t cur_time)
     current_time = &sources[source_type]->current_time;
     time_delta = &sources[source_type]->time_delta;
     active_source = source_type;
+    //the source starts its own sequence every time, whatever ran before it
+    Random_seed(&sources[source_type]->random, ((uint64_t)led_param.seed << 32) | (uint64_t)source_type);
+    Random_set_current(&sources[source_type]->random);
     sources[source_type]->init(led_param.led_count, led_param.time_speed, cur_time);
 }
 
-void SourceManager_init(enum SourceType source_type, int led_count, int time_speed, uint64_t cur_time)
+void SourceManager_init(enum SourceType source_type, int led_count, int time_speed, uint32_t seed, uint64_t cur_time)
 {
     led_param.led_count = led_count;
     led_param.time_speed = time_speed;
+    led_param.seed = seed;
 
     sources[EMBERS_SOURCE] = &fire_source.basic_source;
     sources[PERLIN_SOURCE] = &perlin_source.basic_source;
@@ -208,30 +213,26 @@ void check_message()
     {
         return;
     }
-    if (strnlen(msg, MAX_MSG_LENGTH) >= MAX_MSG_LENGTH) 
-    {
-        printf("Message too long: %s, %zi", msg, strlen(msg));
-        goto quit;
-    }
     char command[MAX_CMD_LENGTH];
-    char param[MAX_MSG_LENGTH];
-    int n = sscanf(msg, "LED %s %s", command, param);
-    if (n != 2)
+    char* message = NULL;
+    int offset = 0;
+    int n = sscanf(msg, "LED %63s %n", command, &offset);
+    //the parameter is processed in place, sources check its length themselves, e.g. key frames may take a lot
+    char* param = msg + offset;
+    param[strcspn(param, " \t\r\n")] = 0x0;
+    if (n != 1 || offset == 0 || *param == 0x0)
     {
         printf("Unknown message received %s\n", msg);
         goto quit;
     }
-    //make sure strings are null-terminated
-    command[MAX_CMD_LENGTH - 1] = 0x0;
-    param[MAX_MSG_LENGTH - 1] = 0x0;
     if (!strncasecmp(command, "SOURCE", 6))
     {
         process_source_message(param);
     }
     else if (!strncasecmp(command, "MSG", 3))
     {
-        char message[MAX_MSG_LENGTH];
-        if (decode(param, message) < 0)
+        message = malloc(strlen(param) + 1);
+        if (message == NULL || decode(param, message) < 0)
         {
             printf("Malformatted URL-encoded text: %s\n", param);
             goto quit;
@@ -249,6 +250,7 @@ void check_message()
         goto quit;
     }
 quit:    
+    free(message);
     free(msg);
 }
 
@@ -19,6 +19,9 @@
 #include "common_source.h"
 #include "colours.h"
 #include "xmas_source.h"
+#include "geometry.h"
+#include "period_bank.h"
+#include "particles.h"
 
 
 static struct {
@@ -45,6 +48,9 @@ static struct {
     int beat_length;
     //valeria
     float valeria_speed;
+    //ripples
+    float ripple_speed;
+    float ripple_chance;
     //random
     int is_random;
 } config;
@@ -74,145 +80,14 @@ glitter_config_t glt2_config;
 
 #pragma region Geometry
 
-typedef enum dir {
-    UP,
-    RIGHT = 2,
-    DOWN = 4,
-    LEFT = 6,
-    FORWARD = 8,
-    BACKWARD = 10,
-    HEIGHT = 12
-} dir_t;
-
-//neighbors of i-the led and their distance:
-// index of upper neighbor, distance to upper neighbor, index of right neighbor, distance to right neighbor, ...
-// order is up, right, down, left
-// the last column (12) is the height, i.e. how many leds there are below me
-static struct {
-    int (*neighbors)[HEIGHT + 1];
-    int* heads;
-    int* springs;
-    int n_heads;
-    int n_springs;
-} geometry;
-
-//Geometry calculations {{{ 
-// These functions are only called during init
-
-// 'head' is a led such that 
-// (geometry[head][DOWN] != -1) &&  <-- there is something below me
-// (geometry[geometry[head][DOWN]][UP] == head) <-- The led below me points back to me
-// ((geometry[head][UP] == -1) || (geometry[geometry[head][UP]][DOWN] != head)) && <-- I am either top, or the led above does not point back to me
-//           1               geometry[1][UP] = -1; geometry[1][DOWN] = 2
-//           |\              geometry[2][UP] =  1; geometry[2][DOWN] = 4
-//           2-3             geometry[3][UP] =  1; geometry[3][DOWN] = 5
-//           | |\            geometry[4][UP] =  2; geometry[4][DOWN] = 7
-//           4-5-6           geometry[5][UP] =  3; geometry[5][DOWN] = 7
-//            \|\|           geometry[6][UP] =  3; geometry[6][DOWN] = 8
-//             7 8           geometry[7][UP] =  5; geometry[8][UP] = 6
-// Heads are 1, 3, 6
-// Springs are like heads, but at the bottom
-static int check_terminal(int led, dir_t flow_from, dir_t flow_to)
-{
-    return (
-        (geometry.neighbors[led][flow_from] != -1) &&  //there is something in the direction of flow
-        (geometry.neighbors[geometry.neighbors[led][flow_from]][flow_to] == led) && //I am upstream from the led in the direction of flow
-        ((geometry.neighbors[led][flow_to] == -1) || (geometry.neighbors[geometry.neighbors[led][flow_to]][flow_from] != led)) //I am either end of flow, or the led upstream from me does not flow back to me
-        );
-}
-
-static void find_heads_and_springs()
-{
-    geometry.heads = malloc(sizeof(int) * xmas_source.basic_source.n_leds / 2); //there can never be that many heads or springs, but I don't care about saving few bytes of memory
-    geometry.springs = malloc(sizeof(int) * xmas_source.basic_source.n_leds / 2);
-    geometry.n_heads = 0;
-    geometry.n_springs = 0;
-    for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
-    {
-        if (check_terminal(led, DOWN, UP))
-        {
-            geometry.heads[geometry.n_heads++] = led;
-        }
-        if (check_terminal(led, UP, DOWN))
-        {
-            geometry.springs[geometry.n_springs++] = led;
-        }
-    }
-    //debug output
-    printf("HEADS: ");
-    for (int i = 0; i < geometry.n_heads; ++i) printf("%d, ", geometry.heads[i]);
-    printf("\nSPRINGS: ");
-    for (int i = 0; i < geometry.n_springs; ++i) printf("%d, ", geometry.springs[i]);
-    printf("\n");
-}
-
-
-static void calculate_height()
-{
-    for (int i = 0; i < xmas_source.basic_source.n_leds; ++i)
-    {
-        if (geometry.neighbors[i][HEIGHT] != -1) //we have been here already
-            continue;
-
-        int down = geometry.neighbors[i][DOWN];
-        int depth = 0;
-        while (down != -1 && geometry.neighbors[down][HEIGHT] == -1)
-        {
-            depth++;
-            down = geometry.neighbors[down][DOWN];
-        }
-        if (down != -1) //we are not at the bottom but we were here already
-        {
-            depth += geometry.neighbors[down][HEIGHT] + 1;
-        }
-        geometry.neighbors[i][HEIGHT] = depth;
-        down = geometry.neighbors[i][DOWN];
-        while (down != -1 && geometry.neighbors[down][HEIGHT] == -1)
-        {
-            geometry.neighbors[down][HEIGHT] = --depth;
-            down = geometry.neighbors[down][DOWN];
-        }
-    }
-}
+static geometry_t geometry;
 
 static int XmasSource_read_geometry()
 {
-    geometry.neighbors = malloc(xmas_source.basic_source.n_leds * sizeof(*geometry.neighbors));
-    FILE* fgeom = fopen("geometry", "r");
-    if (fgeom == NULL) {
-        printf("Geometry file not found\n");
+    if (!Geometry_load(&geometry, xmas_source.basic_source.n_leds))
+    {
         exit(-4);
     }
-    int row = 0;
-    while (row < xmas_source.basic_source.n_leds)
-    {
-        int n = fscanf(fgeom, "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
-            &geometry.neighbors[row][UP], &geometry.neighbors[row][UP + 1],
-            &geometry.neighbors[row][RIGHT], &geometry.neighbors[row][RIGHT + 1],
-            &geometry.neighbors[row][DOWN], &geometry.neighbors[row][DOWN + 1],
-            &geometry.neighbors[row][LEFT], &geometry.neighbors[row][LEFT + 1]);
-        if (n != 8)
-        {
-            printf("Error reading geometry\n");
-            return 0;
-        }
-        geometry.neighbors[row][FORWARD] = row + 1;
-        geometry.neighbors[row][FORWARD + 1] = 1;
-        geometry.neighbors[row][BACKWARD] = row - 1;
-        geometry.neighbors[row][BACKWARD + 1] = 1;
-        geometry.neighbors[row][HEIGHT] = -1;
-        row++;
-    }
-    // the last led has its FORWARD neighbor set to n_leds not
-    geometry.neighbors[xmas_source.basic_source.n_leds - 1][FORWARD] = -1;
-    /* //debug print line 90
-    printf("Row 90: %d %d - %d %d - %d %d - %d %d\n", xmas_source.geometry[90][UP], xmas_source.geometry[90][UP+1],
-            xmas_source.geometry[90][RIGHT], xmas_source.geometry[90][RIGHT+1],
-            xmas_source.geometry[90][DOWN], xmas_source.geometry[90][DOWN+1],
-            xmas_source.geometry[90][LEFT], xmas_source.geometry[90][LEFT+1]);
-    */
-    calculate_height();
-    find_heads_and_springs();
     return 1;
 }
 
@@ -222,142 +97,155 @@ static int XmasSource_read_geometry()
 
 static long random_time_start;
 
-typedef struct PeriodData {
-    //all are times in ms
-    unsigned long lastChange;
-    unsigned long nextChange;
-    unsigned long basePeriod;
-    unsigned long periodRange;
-    double phaseShift;
-} period_data_t;
-
 unsigned long current_time_in_ms()
 {
     return (unsigned long)(xmas_source.basic_source.current_time / (uint64_t)1e6);
 }
 
-/**
-* Generate linearly increasing number from 0 to 2 * pi, with some random variation
-* The length of the period is within interval basePeriod +- 0.5 * periodRange
-* Once 2*pi angle is reached, new period is calculated
-*/
-double get_angle(period_data_t* period_data)
+#define XMAS_RAMP_STEPS 64      //colours between two stops are precomputed in this many steps
+
+/*! Colour of a ramp filled by `fill_hsl_ramp` at `t` from 0 to 1 */
+static inline ws2811_led_t ramp_at(const ws2811_led_t* ramp, float t)
 {
-    unsigned long cur_time = current_time_in_ms();
-    if (cur_time >= period_data->nextChange)
-    {
-        period_data->lastChange = period_data->nextChange;
-        period_data->nextChange = cur_time + period_data->basePeriod + (long)((random_01() - 0.5f) * period_data->periodRange);
-    }
-    return 2 * M_PI * (double)(cur_time - period_data->lastChange) / (double)(period_data->nextChange - period_data->lastChange) + period_data->phaseShift;
+    int i = (int)(t * (XMAS_RAMP_STEPS - 1) + 0.5f);
+    if (i < 0) i = 0;
+    if (i >= XMAS_RAMP_STEPS) i = XMAS_RAMP_STEPS - 1;
+    return ramp[i];
 }
 
-typedef struct MovingLed {
-    int origin;     // index of the LED where the motion started
-    float distance; // distance from origin, 0 to 1
-    dir_t direction;
-    float speed;    // in leds per second
-    int stop_at_destination; // 0 - continue movement, 1 stop at destination
-    int is_moving;  // 0 - not moving, 1 - is moving
-    int next_stop;
-    int destination;
-} moving_led_t;
+#define XMAS_PARTICLES_MIN 256   //the pool of moving leds has at least this many particles, or as many as there are leds
+
+static particles_t particles;
+
+#pragma endregion
+
+#pragma region Snowflakes
 
-void MovingLed_move(moving_led_t* moving_led)
+#define SNOWFLAKE_LEVELS    64      //lightness of snowflakes is quantized to this many levels
+#define SPEC_LUT_LEN      1024
+
+enum SnowflakeRamp {
+    SF_CENTRE,      //edge to centre, the led of the snowflake
+    SF_NEXT,        //centre to edge, the led where the snowflake moves
+    SF_EDGE,        //black to edge, the leds around
+    SF_TAIL,        //edge to black, the leds around the next one
+    SF_N_RAMPS
+};
+
+static period_bank_t diff_periods;
+static period_bank_t spec_periods;
+static float* snowflake_diffuse;
+static float spec_lut[SPEC_LUT_LEN];    // k_spec * cos^spec over one period
+static float snowflake_l_min;
+static float snowflake_l_step;
+static ws2811_led_t snowflake_ramps[SNOWFLAKE_LEVELS][SF_N_RAMPS][XMAS_RAMP_STEPS];
+
+/*!
+ * @brief The colours of a snowflake depend only on its lightness and position between leds, so they are precomputed
+ *        for every lightness level the diffuse and specular terms can reach
+ */
+static void Snowflakes_init_ramps()
 {
-    if (moving_led->is_moving == 0)
-        return;
-    double time_seconds = (xmas_source.basic_source.time_delta / (long)1e3) / (double)1e6;
-    moving_led->distance += moving_led->speed * (float)time_seconds;
-    if (moving_led->distance >= 1.0f)
+    hsl_t snowflake_colors[3]; // 0 is black before and after, 2 is the actual snowflake, 1 is the edge
+    rgb2hsl(xmas_source.basic_source.gradient.colors[config.snowflake_color], &snowflake_colors[2]);
+    rgb2hsl(xmas_source.basic_source.gradient.colors[config.snowflake_color+1], &snowflake_colors[1]);
+    snowflake_colors[0] = snowflake_colors[1];
+    snowflake_colors[0].l = 0.f;
+    //for(int i = 0; i < 3; ++i) printf("Color %i -- h: %f, s: %f, l: %f\n", i, snowflake_colors[i].h, snowflake_colors[i].s, snowflake_colors[i].l);
+
+    float spec_min = 0, spec_max = 0;
+    for (int i = 0; i < SPEC_LUT_LEN; ++i)
     {
-        moving_led->distance -= 1;
-        if (moving_led->distance > 1.0f) //this should never happen, it means that we have travelled more than one led distance in one frame
-        {
-            moving_led->distance = 0.9f;
-        }
-        moving_led->origin = geometry.neighbors[moving_led->origin][moving_led->direction];
-        if ((geometry.neighbors[moving_led->origin][moving_led->direction] == -1) // we cannot keep moving in this direction
-            || (moving_led->destination == moving_led->origin && moving_led->stop_at_destination))  // or we are supposed to stop at destination and we have arrived
-        {
-            moving_led->distance = 0.0f;
-            moving_led->is_moving = 0;
-        }
+        spec_lut[i] = config.k_spec * (float)pow(cos(2 * M_PI * i / SPEC_LUT_LEN), config.spec);
+        if (spec_lut[i] < spec_min) spec_min = spec_lut[i];
+        if (spec_lut[i] > spec_max) spec_max = spec_lut[i];
+    }
+    snowflake_l_min = -config.k_diff + spec_min;
+    snowflake_l_step = (2 * config.k_diff + spec_max - spec_min) / (SNOWFLAKE_LEVELS - 1);
+
+    for (int level = 0; level < SNOWFLAKE_LEVELS; ++level)
+    {
+        double l = snowflake_l_min + level * snowflake_l_step;
+        hsl_t centre_col = snowflake_colors[2];
+        centre_col.l += (float)l;
+        if (centre_col.l + l > 1.f) centre_col.l = 1.f;
+        hsl_t edge_col = snowflake_colors[1];
+        edge_col.l += (float)pow(l, 2);
+        if (edge_col.l > 1.f) edge_col.l = 1.f;
+        hsl_t black_col = snowflake_colors[0];
+        //the hue must not drift while the snowflake moves, the ramps stay between the hues of their ends
+        float snowflake_hue = centre_col.h;
+        assert((edge_col.h - snowflake_hue) * (edge_col.h - snowflake_hue) < 0.01);
+        assert((black_col.h - snowflake_hue) * (black_col.h - snowflake_hue) < 0.01);
+        fill_hsl_ramp(snowflake_ramps[level][SF_CENTRE], XMAS_RAMP_STEPS, &edge_col, &centre_col);
+        fill_hsl_ramp(snowflake_ramps[level][SF_NEXT], XMAS_RAMP_STEPS, &centre_col, &edge_col);
+        fill_hsl_ramp(snowflake_ramps[level][SF_EDGE], XMAS_RAMP_STEPS, &black_col, &edge_col);
+        fill_hsl_ramp(snowflake_ramps[level][SF_TAIL], XMAS_RAMP_STEPS, &edge_col, &black_col);
     }
-    moving_led->next_stop = geometry.neighbors[moving_led->origin][moving_led->direction];
 }
 
-int MovingLed_get_intensity(moving_led_t* moving_led, float* at_origin, float* at_destination)
+static void Snowflakes_destruct()
 {
-    *at_origin = (1.f - moving_led->distance);
-    *at_destination = moving_led->distance;
-    /*
-    if(moving_led->distance > 0.5f)
+    free(snowflake_diffuse);
+    snowflake_diffuse = NULL;
+    PeriodBank_free(&diff_periods);
+    PeriodBank_free(&spec_periods);
+}
+
+/*!
+ * @brief Allocations and ramps, they are kept across mode switches
+ * @returns 0 when the memory cannot be allocated, the mode then shows no snowflakes
+ */
+static int Snowflakes_prepare()
+{
+    if (config.n_snowflakes > particles.capacity)
     {
-        *at_origin = 0.f;
-        *at_destination = 1.f;
+        printf("Only %i snowflakes fit in the pool\n", particles.capacity);
+        config.n_snowflakes = particles.capacity;
     }
-    else
+    snowflake_diffuse = malloc(sizeof(float) * config.n_snowflakes);
+    double* spec_shift = malloc(sizeof(double) * config.n_snowflakes);
+    int ok = snowflake_diffuse && spec_shift;
+    if (ok)
+    {
+        for (int flake = 0; flake < config.n_snowflakes; ++flake)
+        {
+            spec_shift[flake] = config.spec_phase;
+        }
+        ok = PeriodBank_init(&diff_periods, config.n_snowflakes, config.diff_base_period, config.diff_period_range, NULL) &&
+            PeriodBank_init(&spec_periods, config.n_snowflakes, config.spec_base_period, config.spec_period_range, spec_shift);
+    }
+    free(spec_shift);
+    if (!ok)
     {
-        *at_origin = 1.f;
-        *at_destination = 0.f;
-    }// */
+        printf("Cannot allocate memory for snowflakes\n");
+        Snowflakes_destruct();
+        return 0;
+    }
+    Snowflakes_init_ramps();
     return 1;
 }
 
-#pragma endregion
-
-#pragma region Snowflakes
-
-static moving_led_t* snowflakes;
-static period_data_t* diff_data;
-static period_data_t* spec_data;
-static hsl_t snowflake_colors[3]; // 0 is black before and after, 2 is the actual snowflake, 1 is the edge
-
 void Snowflakes_init()
 {
-    snowflakes = malloc(sizeof(moving_led_t) * config.n_snowflakes);
-    diff_data = malloc(sizeof(period_data_t) * config.n_snowflakes);
-    spec_data = malloc(sizeof(period_data_t) * config.n_snowflakes);
-    if (!snowflakes || !diff_data || !spec_data)
-    {
-        printf("Cannot allocate memory for snowflakes\n");
-        return;
-    }
     int d = (int)(xmas_source.basic_source.n_leds / config.n_snowflakes);
-    unsigned long cur_time = current_time_in_ms();
+    //snowflakes are the only particles, so snowflake i is particle i
+    Particles_clear(&particles);
     for (int flake = 0; flake < config.n_snowflakes; ++flake)
     {
-        diff_data[flake].nextChange  = cur_time - 1;
-        diff_data[flake].basePeriod  = config.diff_base_period;
-        diff_data[flake].periodRange = config.diff_period_range;
-        diff_data[flake].phaseShift  = 0;
-        spec_data[flake].nextChange  = cur_time - 1;
-        spec_data[flake].basePeriod  = config.spec_base_period;
-        spec_data[flake].periodRange = config.spec_period_range;
-        spec_data[flake].phaseShift  = config.spec_phase;
-
-        snowflakes[flake].origin = flake * d;
-        snowflakes[flake].speed = 0.5f;
-        snowflakes[flake].distance = 0;
-        snowflakes[flake].is_moving = 0;
-        snowflakes[flake].stop_at_destination = 1;
-    }
-    for(int i=0;i<config.n_snowflakes;++i) printf("Flake %d origin %d\n",i,snowflakes[i].origin);
-    rgb2hsl(xmas_source.basic_source.gradient.colors[config.snowflake_color], &snowflake_colors[2]);
-    rgb2hsl(xmas_source.basic_source.gradient.colors[config.snowflake_color+1], &snowflake_colors[1]);
-    snowflake_colors[0] = snowflake_colors[1];
-    snowflake_colors[0].l = 0.f;
-    //for(int i = 0; i < 3; ++i) printf("Color %i -- h: %f, s: %f, l: %f\n", i, snowflake_colors[i].h, snowflake_colors[i].s, snowflake_colors[i].l);
+        Particles_add(&particles, flake * d, UP, 0.5f);
+        particles.is_moving[flake] = 0;
+        particles.stop_at_destination[flake] = 1;
+    }
+    for(int i=0;i<config.n_snowflakes;++i) printf("Flake %d origin %d\n",i,particles.origin[i]);
 }
 
 void Snowflakes_update()
 {
     for (int flake = 0; flake < config.n_snowflakes; flake++)
     {
-        if(snowflakes[flake].is_moving)
+        if(particles.is_moving[flake])
         {
-            MovingLed_move(&snowflakes[flake]);
             continue;
         }
         if (random_01() < config.move_chance)
@@ -367,42 +255,50 @@ void Snowflakes_update()
             float r01 = random_01();
             int dir = (r01 < config.down_chance) ? DOWN : (r01 < (config.down_chance + config.left_chance) ? LEFT : RIGHT);
             //check if there is a led in this direction
-            if ((geometry.neighbors[snowflakes[flake].origin][dir] == -1) || (geometry.neighbors[snowflakes[flake].origin][dir + 1] != 1))
+            int origin = particles.origin[flake];
+            if ((geometry.neighbor[origin][dir] == -1) || (geometry.distance[origin][dir] != 1))
             {
                 dir = DOWN; //if we can't move in the desired direction, we can try to go DOWN
             }
-            if (geometry.neighbors[snowflakes[flake].origin][dir] != -1)
+            if (geometry.neighbor[origin][dir] != -1)
             {
-                snowflakes[flake].direction = dir;
-                snowflakes[flake].is_moving = 1;
+                particles.direction[flake] = dir;
+                particles.is_moving[flake] = 1;
             }
             else
             {
                 //we cannot move this snowflake any further, so we shall spawn a new one
                 int new_flake = (int)(random_01() * geometry.n_heads);
-                snowflakes[flake].origin = geometry.heads[new_flake];
+                particles.origin[flake] = geometry.heads[new_flake];
                 printf("Spawning new flake %i at %d\n", flake, new_flake);
             }
         }
     }
+    //flakes that have just started move in this frame already
+    Particles_update(&particles, &geometry, xmas_source.basic_source.time_delta);
     //printf("SF update finished\n");
 }
 
 static void add_close_neighbor(int* add_to, int add_index, int led_index, dir_t dir)
 {
-    if(geometry.neighbors[led_index][dir + 1] == 1)
+    if(led_index != -1 && geometry.distance[led_index][dir] == 1)
     {
-        add_to[add_index] = geometry.neighbors[led_index][dir];
+        add_to[add_index] = geometry.neighbor[led_index][dir];
     }
 }
 
 static int update_leds_snowflake(ws2811_t* ledstrip)
 {
-    Snowflakes_update();
     for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
     {
         ledstrip->channel[0].leds[led] = 0;
     }
+    if (snowflake_diffuse == NULL)
+        return 1;
+    Snowflakes_update();
+    PeriodBank_advance(&diff_periods, xmas_source.basic_source.time_delta);
+    PeriodBank_advance(&spec_periods, xmas_source.basic_source.time_delta);
+    PeriodBank_cos(&diff_periods, 0, config.k_diff, snowflake_diffuse);
 
     // we shall create a structure for the leds influenced by the current snowflakes
     //      4 7
@@ -411,62 +307,47 @@ static int update_leds_snowflake(ws2811_t* ledstrip)
     int flake_leds[8];
     for (int flake = 0; flake < config.n_snowflakes; ++flake)
     {
-        flake_leds[0] = snowflakes[flake].origin;
+        flake_leds[0] = particles.origin[flake];
         for(int i = 1; i < 8; ++i)
         {
             flake_leds[i] = -1;
         }
         dir_t dir = UP;
-        if (snowflakes[flake].is_moving)
+        if (particles.is_moving[flake])
         {
-            dir = snowflakes[flake].direction;
+            dir = (dir_t)particles.direction[flake];
         }
         for (int i = 0; i < 4; ++i)
         {
-            add_close_neighbor(flake_leds, i + 1, flake_leds[0], (dir + 2 * i) % 8);
+            add_close_neighbor(flake_leds, i + 1, flake_leds[0], (dir + i) % N_COMPASS_DIRS);
         }
-        if (snowflakes[flake].is_moving)
+        if (particles.is_moving[flake])
         {
             add_close_neighbor(flake_leds, 5, flake_leds[1], dir);
-            add_close_neighbor(flake_leds, 6, flake_leds[1], (dir + 2) % 8);
-            add_close_neighbor(flake_leds, 7, flake_leds[1], (dir + 6) % 8);
+            add_close_neighbor(flake_leds, 6, flake_leds[1], (dir + 1) % N_COMPASS_DIRS);
+            add_close_neighbor(flake_leds, 7, flake_leds[1], (dir + 3) % N_COMPASS_DIRS);
         }
 
-        float origin_intensity, destination_intensity;
-        MovingLed_get_intensity(&snowflakes[flake], &origin_intensity, &destination_intensity);
-
-        double diff_alpha = get_angle(&diff_data[flake]);
-        double spec_alpha = get_angle(&spec_data[flake]);
-        double l = config.k_diff * cos(diff_alpha) + config.k_spec * pow(cos(spec_alpha), config.spec);
+        float origin_intensity = 1.f - particles.distance[flake];
 
-        hsl_t centre_col = snowflake_colors[2];
-        float snowflake_hue = centre_col.h;
-        centre_col.l += (float)l;
-        if (centre_col.l + l > 1.f) centre_col.l = 1.f;
-        hsl_t edge_col = snowflake_colors[1];
-        edge_col.l += (float)pow(l, 2);
-        if (edge_col.l > 1.f) edge_col.l = 1.f;
-        hsl_t black_col = snowflake_colors[0];
+        float l = snowflake_diffuse[flake] + spec_lut[(int)(PeriodBank_turns(&spec_periods, flake) * SPEC_LUT_LEN)];
+        int level = (int)((l - snowflake_l_min) / snowflake_l_step + 0.5f);
+        if (level < 0) level = 0;
+        if (level >= SNOWFLAKE_LEVELS) level = SNOWFLAKE_LEVELS - 1;
+        ws2811_led_t (*ramps)[XMAS_RAMP_STEPS] = snowflake_ramps[level];
         //now set all leds
-        hsl_t res;
-        lerp_hsl(&edge_col, &centre_col, origin_intensity, &res);
-        assert((res.h - snowflake_hue) * (res.h - snowflake_hue) < 0.01);
-        ledstrip->channel[0].leds[flake_leds[0]] = hsl2rgb(&res);
-        lerp_hsl(&centre_col, &edge_col, origin_intensity, &res);
-        assert((res.h - snowflake_hue) * (res.h - snowflake_hue) < 0.01);
+        ledstrip->channel[0].leds[flake_leds[0]] = ramp_at(ramps[SF_CENTRE], origin_intensity);
         if (flake_leds[1] != -1) 
-            ledstrip->channel[0].leds[flake_leds[1]] = hsl2rgb(&res);
-        lerp_hsl(&black_col, &edge_col, origin_intensity, &res);
-        assert((res.h - snowflake_hue) * (res.h - snowflake_hue) < 0.01);
+            ledstrip->channel[0].leds[flake_leds[1]] = ramp_at(ramps[SF_NEXT], origin_intensity);
+        ws2811_led_t col = ramp_at(ramps[SF_EDGE], origin_intensity);
         for (int i = 2; i < 5; ++i) // 2,5
         {
-            if (flake_leds[i] != -1) ledstrip->channel[0].leds[flake_leds[i]] = hsl2rgb(&res);
+            if (flake_leds[i] != -1) ledstrip->channel[0].leds[flake_leds[i]] = col;
         }
-        lerp_hsl(&edge_col, &black_col, origin_intensity, &res);
-        assert((res.h - snowflake_hue) * (res.h - snowflake_hue) < 0.01);
+        col = ramp_at(ramps[SF_TAIL], origin_intensity);
         for (int i = 5; i < 8; ++i) //5,8
         {
-            if (flake_leds[i] != -1) ledstrip->channel[0].leds[flake_leds[i]] = hsl2rgb(&res);
+            if (flake_leds[i] != -1) ledstrip->channel[0].leds[flake_leds[i]] = col;
         }
     }
     return 1;
@@ -476,81 +357,123 @@ static int update_leds_snowflake(ws2811_t* ledstrip)
 
 #pragma region Glitter
 
-static int select_glitter_color()
+static int select_glitter_color(const glitter_config_t* cfg, float r01)
 {
     //1 - green 30% , 2 -- red 30%, 3 -- bright orange 10%, 4 -- purple 10%, 5 -- blue 20%
-    float r01 = random_01();
-    if (r01 < glitter_config->prob1) return glitter_config->color + 0; else r01 -= glitter_config->prob1;
-    if (r01 < glitter_config->prob2) return glitter_config->color + 1; else r01 -= glitter_config->prob2;
-    if (r01 < glitter_config->prob3) return glitter_config->color + 2; else r01 -= glitter_config->prob3;
-    if (r01 < glitter_config->prob4) return glitter_config->color + 3;
+    if (r01 < cfg->prob1) return cfg->color + 0; else r01 -= cfg->prob1;
+    if (r01 < cfg->prob2) return cfg->color + 1; else r01 -= cfg->prob2;
+    if (r01 < cfg->prob3) return cfg->color + 2; else r01 -= cfg->prob3;
+    if (r01 < cfg->prob4) return cfg->color + 3;
     return 4;
 }
 
-static period_data_t* glitter_periods;
-static ws2811_led_t* glitter_colors;
+typedef struct GlitterState
+{
+    period_bank_t periods;
+    float* intensity;
+    ws2811_led_t* colors;
+} glitter_state_t;
+
+static glitter_state_t glitter_states[2];   //glitter and glitter2 keep their own colours and periods
+static glitter_state_t* glitter;            //the one being shown
+
+static void Glitter_destruct(glitter_state_t* state)
+{
+    PeriodBank_free(&state->periods);
+    free(state->intensity);
+    free(state->colors);
+    state->intensity = NULL;
+    state->colors = NULL;
+}
 
-static void Glitter_init_common()
+/*! @returns 0 when the memory cannot be allocated, the mode then stays black */
+static int Glitter_prepare_common(glitter_state_t* state, const glitter_config_t* cfg)
 {
-    glitter_periods = malloc(sizeof(period_data_t) * xmas_source.basic_source.n_leds);
-    glitter_colors = malloc(sizeof(ws2811_led_t) * xmas_source.basic_source.n_leds);
-    if (!glitter_periods || !glitter_colors)
+    int n_leds = xmas_source.basic_source.n_leds;
+    double* phase_shift = malloc(sizeof(double) * n_leds);
+    float* r01 = malloc(sizeof(float) * 2 * n_leds);    //colour and phase of every LED, drawn at once in the order they are used
+    state->intensity = malloc(sizeof(float) * n_leds);
+    state->colors = malloc(sizeof(ws2811_led_t) * n_leds);
+    if (!phase_shift || !r01 || !state->intensity || !state->colors)
     {
         printf("Cannot allocate memory for glitter.\n");
-        return;
+        free(phase_shift);
+        free(r01);
+        Glitter_destruct(state);
+        return 0;
     }
-    unsigned long cur_time = current_time_in_ms();
-    for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
+    random_01_n(r01, 2 * n_leds);
+    for (int led = 0; led < n_leds; ++led)
+    {
+        int col = select_glitter_color(cfg, r01[2 * led]);
+        state->colors[led] = xmas_source.basic_source.gradient.colors[col];
+        phase_shift[led] = cfg->phase_constant +
+            cfg->phase_position * (double)led / (double)n_leds +
+            cfg->phase_random * r01[2 * led + 1];
+        //printf("Setting led %d to shift %f\n", led, phase_shift[led]);
+    }
+    int ok = PeriodBank_init(&state->periods, n_leds, cfg->base_period, cfg->period_range, phase_shift);
+    free(phase_shift);
+    free(r01);
+    if (!ok)
     {
-        int col = select_glitter_color();
-        glitter_colors[led] = xmas_source.basic_source.gradient.colors[col];
-        glitter_periods[led].nextChange = cur_time - 1;
-        glitter_periods[led].basePeriod = glitter_config->base_period;
-        glitter_periods[led].periodRange = glitter_config->period_range;
-        glitter_periods[led].phaseShift = glitter_config->phase_constant +
-            glitter_config->phase_position * (double)led / (double)xmas_source.basic_source.n_leds +
-            glitter_config->phase_random * random_01();
-        //printf("Setting led %d to shift %f\n", led, glitter_periods[led].phaseShift);
+        printf("Cannot allocate memory for glitter.\n");
+        Glitter_destruct(state);
     }
+    return ok;
 }
 
-static void Glitter1_init()
+static int Glitter1_prepare()
 {
-    glitter_config = &glt1_config;
-    Glitter_init_common();
+    if (!Glitter_prepare_common(&glitter_states[0], &glt1_config))
+        return 0;
     printf("Glitter 1 initialized\n");
+    return 1;
 }
 
-static void Glitter2_init()
+static int Glitter2_prepare()
 {
-    glitter_config = &glt2_config;
-    Glitter_init_common();
+    if (!Glitter_prepare_common(&glitter_states[1], &glt2_config))
+        return 0;
     printf("Glitter 2 initialized\n");
+    return 1;
 }
 
-static void Glitter_destruct()
+static void Glitter1_init()
 {
-    free(glitter_periods);
-    free(glitter_colors);
+    glitter_config = &glt1_config;
+    glitter = &glitter_states[0];
+}
+
+static void Glitter2_init()
+{
+    glitter_config = &glt2_config;
+    glitter = &glitter_states[1];
 }
 
 static int update_leds_glitter(ws2811_t* ledstrip)
 {
+    if (glitter->colors == NULL)
+    {
+        memset(ledstrip->channel[0].leds, 0, sizeof(ws2811_led_t) * xmas_source.basic_source.n_leds);
+        return 1;
+    }
+    //the periods run on even when no led is updated
+    PeriodBank_advance(&glitter->periods, xmas_source.basic_source.time_delta);
     //in all subsequent updates there is a chance that exactly one led will be set to new colour (or possibly the same colour)
     if (random_01() < glitter_config->glitter_chance)
     {
         int led = (int)(random_01() * xmas_source.basic_source.n_leds);
-        int col = select_glitter_color();
-        glitter_colors[led] = xmas_source.basic_source.gradient.colors[col];
+        int col = select_glitter_color(glitter_config, random_01());
+        glitter->colors[led] = xmas_source.basic_source.gradient.colors[col];
         //printf("Resetting led %d to color %x\n", led, xmas_source.basic_source.gradient.colors[col]);
         return 1;
     }
+    PeriodBank_cos(&glitter->periods, glitter_config->amp_add, glitter_config->amp_mul, glitter->intensity);
     for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
     {
-        double angle = get_angle(&glitter_periods[led]);
-        double t = glitter_config->amp_add + glitter_config->amp_mul * cos(angle);
-        ledstrip->channel[0].leds[led] = multiply_rgb_color(glitter_colors[led], t);
-        //printf("%f  ", t);
+        ledstrip->channel[0].leds[led] = multiply_rgb_color(glitter->colors[led], glitter->intensity[led]);
+        //printf("%f  ", glitter->intensity[led]);
     }
     //printf("\n");
     return 1;
@@ -560,88 +483,92 @@ static int update_leds_glitter(ws2811_t* ledstrip)
 
 #pragma region Icicles
 
-static moving_led_t* icicles;
-static hsl_t* icicle_colors; // 0 and 5 are black before and after, the rest is { 6, 7, 8, 9 } in config
+static ws2811_led_t* icicle_ramps; // the top led behind the icicle first, then the body ahead of it
 static const int C_ICICLE_COLOR = 6;
 
-static void Icicles_init()
+/**
+* Every icicle is a particle at the top led. We than render (n_icicle_leds + 1) leds:
+*   Actual LEDs:         o    o    o    o    o
+*   Icicle elements:       *    *    *    *      -> movement
+* We add two black elements in front and in the end and then we interpolate between icicle elements
+* to get the colour of the LED. The led behind the particle is between the black and the first element,
+* the body ahead of it runs through the rest, so it is one ramp with a stop at every element
+*/
+/*! @returns 0 when the memory cannot be allocated, the mode then shows no icicles */
+static int Icicles_prepare()
 {
-    icicle_colors = malloc(sizeof(hsl_t) * (config.n_icicle_leds + 2));
-    icicles = malloc(sizeof(moving_led_t) * geometry.n_heads);
-    if (!icicle_colors || !icicles)
+    int n = (config.n_icicle_leds > 0) ? config.n_icicle_leds : 0;
+    int body_steps = n * (XMAS_RAMP_STEPS - 1) + 1;
+    hsl_t* icicle_colors = malloc(sizeof(hsl_t) * (n + 2)); // 0 and 5 are black before and after, the rest is { 6, 7, 8, 9 } in config
+    icicle_ramps = malloc(sizeof(ws2811_led_t) * (XMAS_RAMP_STEPS + body_steps));
+    if (!icicle_colors || !icicle_ramps)
     {
         printf("Cannot allocate memory for icicles.\n");
-        return;
+        free(icicle_colors);
+        free(icicle_ramps);
+        icicle_ramps = NULL;
+        return 0;
     }
-    for (int i = 0; i < geometry.n_heads; ++i)
+    if (n == 0) //no body, the led behind the head stays black
+    {
+        memset(icicle_colors, 0, sizeof(hsl_t) * 2);
+    }
+    else
     {
-        //printf("h %i\n", geometry.neighbors[geometry.heads[i]][HEIGHT]);
-        if(geometry.neighbors[geometry.heads[i]][HEIGHT] < 3)
+        for (int i = 0; i < n; ++i)
         {
-            icicles[i].origin = -1;
-            continue;
+            rgb2hsl(xmas_source.basic_source.gradient.colors[C_ICICLE_COLOR + i], &icicle_colors[i + 1]);
         }
-        icicles[i].origin = geometry.heads[i];
-        icicles[i].direction = DOWN;
-        icicles[i].distance = 0;
-        icicles[i].speed = config.icicle_speed;
-        icicles[i].stop_at_destination = 0;
-        icicles[i].is_moving = 1;
+        icicle_colors[0] = icicle_colors[1];
+        icicle_colors[0].l = 0.f;
+        icicle_colors[n + 1] = icicle_colors[n];
+        icicle_colors[n + 1].l = 0.f;
+    }
+    fill_hsl_ramp(icicle_ramps, XMAS_RAMP_STEPS, &icicle_colors[0], &icicle_colors[1]);
+    ws2811_led_t* body = icicle_ramps + XMAS_RAMP_STEPS;
+    for (int i = 0; i < n; ++i) //ramps start at the far end, i.e. the bottom of the icicle
+    {
+        fill_hsl_ramp(body + i * (XMAS_RAMP_STEPS - 1), XMAS_RAMP_STEPS, &icicle_colors[n + 1 - i], &icicle_colors[n - i]);
     }
-    for(int i = 0; i < config.n_icicle_leds; ++i)
+    free(icicle_colors);
+    return 1;
+}
+
+static void Icicles_init()
+{
+    int n = (config.n_icicle_leds > 0) ? config.n_icicle_leds : 0;
+    int body_steps = n * (XMAS_RAMP_STEPS - 1) + 1;
+    Particles_clear(&particles);
+    if (icicle_ramps == NULL)
+        return;
+    ws2811_led_t* body = icicle_ramps + XMAS_RAMP_STEPS;
+    for (int i = 0; i < geometry.n_heads; ++i)
     {
-        rgb2hsl(xmas_source.basic_source.gradient.colors[C_ICICLE_COLOR+i], &icicle_colors[i+1]);
+        //printf("h %i\n", geometry.height[geometry.heads[i]]);
+        if(geometry.height[geometry.heads[i]] < 3)
+            continue;
+        int p = Particles_add(&particles, geometry.heads[i], DOWN, config.icicle_speed);
+        if (p == -1)
+            break;
+        particles.respawn[p] = 1;
+        particles.move_chance[p] = 0.5f;
+        particles.behind[p] = 1;
+        particles.behind_ramp[p].colors = icicle_ramps;
+        particles.behind_ramp[p].steps = XMAS_RAMP_STEPS;
+        particles.ahead[p] = (float)n;
+        particles.ahead_ramp[p].colors = (n > 0) ? body : NULL;
+        particles.ahead_ramp[p].steps = body_steps;
     }
-    icicle_colors[0] = icicle_colors[1];
-    icicle_colors[0].l = 0.f;
-    icicle_colors[config.n_icicle_leds + 1] = icicle_colors[config.n_icicle_leds];
-    icicle_colors[config.n_icicle_leds + 1].l = 0.f;
 }
 
-/**
-* Every element in icicles is just the top led. We than render (n_icicle_leds + 1) leds:
-*   Actual LEDs:         o    o    o    o    o
-*   Icicle elements:       *    *    *    *      -> movement
-* We add two black elements in front and in the end and then we interpolate between icicle elements
-* to get the colour of the LED
-*/
 static int update_leds_icicles(ws2811_t* ledstrip)
 {
     for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
     {
         ledstrip->channel[0].leds[led] = 0;
     }
-    for (int i = 0; i < geometry.n_heads; ++i)
-    {
-        if(icicles[i].origin == -1)
-        {
-           continue;
-        }
-        if(random_01() < 0.5)
-            MovingLed_move(&icicles[i]);
-        if (icicles[i].is_moving == 0)
-        {
-            icicles[i].origin = geometry.heads[i];
-            icicles[i].is_moving = 1;
-        }
-        float origin_intensity, destination_intensity;
-        MovingLed_get_intensity(&icicles[i], &origin_intensity, &destination_intensity);
-        int led = icicles[i].origin;
-        hsl_t hsl_out;
-        lerp_hsl(&icicle_colors[0], &icicle_colors[1], origin_intensity, &hsl_out);
-        ledstrip->channel[0].leds[led] = hsl2rgb(&hsl_out);
-        for (int ice_led = 0; ice_led < config.n_icicle_leds; ++ice_led)
-        {
-            led = geometry.neighbors[led][icicles[i].direction];
-            if (led == -1)
-                break;
-            lerp_hsl(&icicle_colors[ice_led+1], &icicle_colors[ice_led+2], origin_intensity, &hsl_out);
-            ledstrip->channel[0].leds[led] = hsl2rgb(&hsl_out);
-            //if(i == 0) printf("Ice led %i: %f\n", led, hsl[2]);
-        }
-        //printf("Updated %d led with intensity %f\n", icicles[i].led.origin, origin_intensity);
-    }
-
+    Particles_update(&particles, &geometry, xmas_source.basic_source.time_delta);
+    Particles_render(&particles, &geometry, ledstrip->channel[0].leds);
     return 1;
 }
 
@@ -654,26 +581,38 @@ static const int XMAS_GRAD2_START = 45;
 #define XMAS_GRAD_LEN 19
 
 static unsigned long start_time = 0;
-static hsl_t grad_colors[XMAS_GRAD_LEN];
+static hsl_t grad1_colors[XMAS_GRAD_LEN];
+static hsl_t grad2_colors[XMAS_GRAD_LEN];
+static hsl_t* grad_colors = grad1_colors; //palette of the gradient being shown
 
-static void Gradient_init()
+static void Gradient_prepare()
 {
-    start_time = current_time_in_ms();
     for (int i = 0; i < XMAS_GRAD_LEN; ++i)
     {
-        rgb2hsl(xmas_source.basic_source.gradient.colors[XMAS_GRAD_START + i], &grad_colors[i]);
+        rgb2hsl(xmas_source.basic_source.gradient.colors[XMAS_GRAD_START + i], &grad1_colors[i]);
     }
 }
 
-static void Gradient2_init(void)
+static void Gradient2_prepare()
 {
-    start_time = current_time_in_ms() + 1;
     for (int i = 0; i < XMAS_GRAD_LEN; ++i)
     {
-        rgb2hsl(xmas_source.basic_source.gradient.colors[XMAS_GRAD2_START + i], &grad_colors[i]);
+        rgb2hsl(xmas_source.basic_source.gradient.colors[XMAS_GRAD2_START + i], &grad2_colors[i]);
     }
 }
 
+static void Gradient_init()
+{
+    start_time = current_time_in_ms();
+    grad_colors = grad1_colors;
+}
+
+static void Gradient2_init(void)
+{
+    start_time = current_time_in_ms() + 1;
+    grad_colors = grad2_colors;
+}
+
 static int update_leds_gradient(ws2811_t* ledstrip)
 {
     double time_shift = (double)(current_time_in_ms() - start_time) / config.gradient_speed;
@@ -710,29 +649,8 @@ static int update_leds_gradient(ws2811_t* ledstrip)
 
 #pragma region Pattern
 
-int rings[200]; //n_leds
-
 static void Pattern_init()
 {
-    for (int spring = 0; spring < geometry.n_springs; ++spring)
-    {
-        rings[geometry.springs[spring]] = 1;  //ring 0
-    }
-    int ring = 1;
-    int up_found = 1;
-    while (up_found)
-    {
-        up_found = 0;
-        for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
-        {
-            if (rings[led] == ring && geometry.neighbors[led][UP] != -1)
-            {
-                rings[geometry.neighbors[led][UP]] = ring + 1;
-                up_found = 1;
-            }
-        }
-        ring++;
-    }
     Gradient_init();
 }
 
@@ -742,7 +660,7 @@ static int update_leds_pattern(ws2811_t* ledstrip)
     int length = 2 * XMAS_GRAD_LEN - 2;
     for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
     {
-        int ring = rings[led];
+        int ring = geometry.ring[led];
         double dindex = fabs(fmod(ring + time_shift, length) - length / 2);
         int index = (int)dindex;
         double offset = dindex - index;
@@ -807,7 +725,7 @@ static int update_leds_pattern(ws2811_t* ledstrip)
 
 #pragma region Fireworks
 
-static moving_led_t flares[255];
+#define FIREWORKS_GENS 7
 static int fireworks_gen = 0;
 static const int firework_color_index = 35;
 static const float flare_speed_at_1 = 21.; //leds per second
@@ -815,22 +733,57 @@ static const float deceleration_at_1 = 2.;  //leds per second squared
 static const int wait_time_at_1 = 250; //in ms
 static int flare_wait_time; //if > 0 we are waiting to spawn next gen, if < 0 wait is over, if == 0 we haven't started waiting yet
 static ws2811_led_t* static_flares;
+static ws2811_led_t firework_ramps[FIREWORKS_GENS][XMAS_RAMP_STEPS]; //from black to the colour of each generation
 
-static void Fireworks_init()
+static void Fireworks_prepare()
 {
     static_flares = malloc(sizeof(ws2811_led_t) * xmas_source.basic_source.n_leds);
+    if (!static_flares)
+    {
+        printf("Cannot allocate memory for fireworks.\n");
+        return;
+    }
+    for (int gen = 0; gen < FIREWORKS_GENS; ++gen)
+    {
+        hsl_t color, black;
+        rgb2hsl(xmas_source.basic_source.gradient.colors[firework_color_index + gen], &color);
+        black = color;
+        black.l = 0;
+        fill_hsl_ramp(firework_ramps[gen], XMAS_RAMP_STEPS, &black, &color);
+    }
+}
+
+static void Fireworks_init()
+{
     fireworks_gen = 0;
+    flare_wait_time = 0;
+    memset(static_flares, 0, sizeof(ws2811_led_t) * xmas_source.basic_source.n_leds); //no flares left over from the last show
+    //flare i is particle i, the last generation has the most of them
+    Particles_clear(&particles);
+    for (int fi = 0; fi < 1 << (FIREWORKS_GENS - 1); ++fi)
+    {
+        int p = Particles_add(&particles, 0, FORWARD, 0);
+        particles.is_alive[p] = 0;
+    }
 }
 
+/*! The flare flies in the next generation, it slows down and fades out towards both neighbours */
 static void Fireworks_init_flare(int fi, int origin, dir_t direction, int destination, float speed)
 {
-    flares[fi].origin = origin;
-    flares[fi].direction = direction;
-    flares[fi].destination = destination;
-    flares[fi].speed = speed;
-    flares[fi].distance = 0;
-    flares[fi].stop_at_destination = 0;
-    flares[fi].is_moving = 1;
+    particles.origin[fi] = origin;
+    particles.direction[fi] = direction;
+    particles.destination[fi] = destination;
+    particles.speed[fi] = speed;
+    particles.acceleration[fi] = -deceleration_at_1 / (1 << fireworks_gen);
+    particles.distance[fi] = 0;
+    particles.stop_at_destination[fi] = 0;
+    particles.is_moving[fi] = 1;
+    particles.is_alive[fi] = 1;
+    particles.behind[fi] = 1;
+    particles.ahead[fi] = 1;
+    particles.behind_ramp[fi].colors = firework_ramps[fireworks_gen];
+    particles.behind_ramp[fi].steps = XMAS_RAMP_STEPS;
+    particles.ahead_ramp[fi] = particles.behind_ramp[fi];
 }
 
 static void Firworks_spawn_next_gen()
@@ -841,7 +794,7 @@ static void Firworks_spawn_next_gen()
     float flare_speed = flare_speed_at_1 / (float)(1 << fireworks_gen);
     for (int fi = 0; fi < cur_gen_end_index; ++fi)
     {
-        int origin = flares[fi].origin;
+        int origin = particles.origin[fi];
         static_flares[origin] = xmas_source.basic_source.gradient.colors[firework_color_index + fireworks_gen - 1];
         Fireworks_init_flare(fi, origin, FORWARD, origin + reach, flare_speed);
         Fireworks_init_flare(cur_gen_end_index + fi, origin, BACKWARD, origin - reach, flare_speed);
@@ -855,6 +808,8 @@ static void Fireworks_update(ws2811_led_t* leds)
     {
         for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
             static_flares[led] = 0x0;
+        for (int fi = 0; fi < particles.n; ++fi)
+            particles.is_alive[fi] = 0;
         //spawn the first flare
         Fireworks_init_flare(0, 1, FORWARD, xmas_source.basic_source.n_leds / 2, flare_speed_at_1);
         fireworks_gen++;
@@ -862,34 +817,19 @@ static void Fireworks_update(ws2811_led_t* leds)
     }
     int cur_gen_end_index = 1 << (fireworks_gen - 1);
     int flares_at_destination = 0;
-    hsl_t color;
-    float deceleration = deceleration_at_1 / (1 << (fireworks_gen - 1));
-    rgb2hsl(xmas_source.basic_source.gradient.colors[firework_color_index + fireworks_gen - 1], &color);
+    Particles_update(&particles, &geometry, xmas_source.basic_source.time_delta);
+    //pos = 5, offset = 0.3 => 5 gets 70%, 6 gets 30% when moving forward
+    Particles_render(&particles, &geometry, leds);
     for (int fi = 0; fi < cur_gen_end_index; ++fi)
     {
-        MovingLed_move(&flares[fi]);
-        double time_seconds = (double)(xmas_source.basic_source.time_delta) / (double)1e9;
-        flares[fi].speed -= deceleration * time_seconds;
-
-        assert(flares[fi].origin >= 0 && flares[fi].origin < xmas_source.basic_source.n_leds);
-        assert(flares[fi].next_stop >= -1 && flares[fi].next_stop < xmas_source.basic_source.n_leds);
-        //pos = 5, offset = 0.3 => 5 gets 70%, 6 gets 30% when moving forward
-        float at_origin, at_next_stop;
-        MovingLed_get_intensity(&flares[fi], &at_origin, &at_next_stop);
-        hsl_t res = color;
-        res.l *= at_origin;
-        leds[flares[fi].origin] = hsl2rgb(&res);
-        if (flares[fi].next_stop != -1)
+        assert(particles.origin[fi] >= 0 && particles.origin[fi] < xmas_source.basic_source.n_leds);
+        assert(particles.next_stop[fi] >= -1 && particles.next_stop[fi] < xmas_source.basic_source.n_leds);
+        int dir = 2 * (particles.direction[fi] == FORWARD) - 1; //+1 when moving forward, -1 when moving backward
+        if ((dir * (particles.destination[fi] - particles.next_stop[fi])) < 1) //we are approaching destination
         {
-            res.l = color.l * at_next_stop;
-            leds[flares[fi].next_stop] = hsl2rgb(&res);
+            particles.stop_at_destination[fi] = 1;
         }
-        int dir = 2 * (flares[fi].direction == FORWARD) - 1; //+1 when moving forward, -1 when moving backward
-        if ((dir * (flares[fi].destination - flares[fi].next_stop)) < 1) //we are approaching destination
-        {
-            flares[fi].stop_at_destination = 1;
-        }
-        if (!flares[fi].is_moving)
+        if (!particles.is_moving[fi])
         {
             flares_at_destination++;
         }
@@ -904,7 +844,7 @@ static void Fireworks_update(ws2811_led_t* leds)
             else
             {
                 flare_wait_time = 0;
-                if (fireworks_gen == 7)
+                if (fireworks_gen == FIREWORKS_GENS)
                     fireworks_gen = 0;
                 else
                     Firworks_spawn_next_gen();
@@ -936,25 +876,42 @@ static int update_leds_fireworks(ws2811_t* ledstrip)
 
 #define C_SLEDGES_TOTAL 16
 #define C_TAIL_MAX 32
-static moving_led_t sledges[C_SLEDGES_TOTAL];
-static hsl_t sledge_colors[C_SLEDGES_TOTAL];
+static ws2811_led_t sledge_heads[C_SLEDGES_TOTAL][XMAS_RAMP_STEPS]; //from black to the colour of the sledge
+static ws2811_led_t sledge_tails[C_SLEDGES_TOTAL][XMAS_RAMP_STEPS]; //from the end of the tail to the sledge
 const double acc = 1.0;  //led/s^2
 
+/*! Sledge i is particle i, it is alive only while it moves */
 static void Sledges_init()
 {
+    Particles_clear(&particles);
     for (int si = 0; si < C_SLEDGES_TOTAL; ++si)
     {
-        sledges[si].origin = xmas_source.basic_source.n_leds - 1;
-        sledges[si].direction = BACKWARD;
-        sledges[si].destination = 0;
-        sledges[si].speed = 0.0;
-        sledges[si].distance = 0;
-        sledges[si].stop_at_destination = 1;
-        sledges[si].is_moving = 0;
+        int p = Particles_add(&particles, xmas_source.basic_source.n_leds - 1, BACKWARD, 0.0f);
+        particles.destination[p] = 0;
+        particles.stop_at_destination[p] = 1;
+        particles.is_moving[p] = 0;
+        particles.is_alive[p] = 0;
+        particles.acceleration[p] = (float)acc;
         int i = random_01() * xmas_source.basic_source.gradient.n_colors;
-        rgb2hsl(xmas_source.basic_source.gradient.colors[i], &sledge_colors[si]);
-    }
-    sledges[0].is_moving = 1;
+        hsl_t sledge_color, black, tail_end;
+        rgb2hsl(xmas_source.basic_source.gradient.colors[i], &sledge_color);
+        black = sledge_color;
+        black.s *= 0.01;
+        black.l *= 0.01;
+        //along the tail lightness fades out and saturation to one half, both linearly
+        tail_end = sledge_color;
+        tail_end.l = 0;
+        tail_end.s *= 0.5f;
+        fill_hsl_ramp(sledge_heads[si], XMAS_RAMP_STEPS, &black, &sledge_color);
+        fill_hsl_ramp(sledge_tails[si], XMAS_RAMP_STEPS, &tail_end, &sledge_color);
+        particles.ahead[p] = 1;
+        particles.ahead_ramp[p].colors = sledge_heads[si];
+        particles.ahead_ramp[p].steps = XMAS_RAMP_STEPS;
+        particles.behind_ramp[p].colors = sledge_tails[si];
+        particles.behind_ramp[p].steps = XMAS_RAMP_STEPS;
+    }
+    particles.is_moving[0] = 1;
+    particles.is_alive[0] = 1;
 }
 
 /*!
@@ -962,20 +919,20 @@ static void Sledges_init()
 */
 static void Sledges_update()
 {
-    double time_seconds = (double)(xmas_source.basic_source.time_delta) / (double)1e9;
+    Particles_update(&particles, &geometry, xmas_source.basic_source.time_delta);
     int moving_sledges = 0;
     for (int si = 0; si < C_SLEDGES_TOTAL; ++si)
     {
-        if (sledges[si].is_moving)
+        particles.is_alive[si] = particles.is_moving[si];
+        if (particles.is_moving[si])
         {
-            sledges[si].speed += acc * time_seconds;
-            MovingLed_move(&sledges[si]);
-            if (si < C_SLEDGES_TOTAL - 1 && sledges[si + 1].is_moving == 0 && sledges[si].origin < xmas_source.basic_source.n_leds * (1.0 - 1.0 / 64.0))
+            if (si < C_SLEDGES_TOTAL - 1 && particles.is_moving[si + 1] == 0 && particles.origin[si] < xmas_source.basic_source.n_leds * (1.0 - 1.0 / 64.0))
             {
-                sledges[si + 1].is_moving = 1;
+                particles.is_moving[si + 1] = 1;
+                particles.is_alive[si + 1] = 1;
             }
             moving_sledges++;
-            //printf("si %i, origin: %i, stop: %i, dist: %f, speed: %f\n", si, sledges[si].origin, sledges[si].next_stop, sledges[si].distance, sledges[si].speed);
+            //printf("si %i, origin: %i, stop: %i, dist: %f, speed: %f\n", si, particles.origin[si], particles.next_stop[si], particles.distance[si], particles.speed[si]);
         }
     }
     if (moving_sledges == 0)
@@ -984,43 +941,20 @@ static void Sledges_update()
     }
 }
 
+/*! The tail grows with speed, it trails behind the sledge, i.e. up the strip */
 static void Sledges_render(ws2811_t* ledstrip)
 {
     for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
     {
         ledstrip->channel[0].leds[led] = 0x0;
     }
-    hsl_t tail[C_TAIL_MAX + 1]; //+1 is for the last black led
     for (int si = 0; si < C_SLEDGES_TOTAL; ++si)
     {
-        if (sledges[si].is_moving)
-        {
-            float tail_len = 1 + sledges[si].speed / 2.0f;
-            if ((int)tail_len >= C_TAIL_MAX) tail_len = C_TAIL_MAX - 1;
-            hsl_t black;
-            black = sledge_colors[si];
-            black.s *= 0.01;
-            black.l *= 0.01;
-            tail[0] = sledge_colors[si];
-            for (int i = 1; i < (int)tail_len + 1; ++i)
-            {
-                tail[i] = tail[0];
-                float aten = (tail_len - i)/tail_len;
-                tail[i].l *= aten; 
-                tail[i].s *= (0.5f + aten/2.0f);
-            }
-            float at_origin, at_next_stop;
-            MovingLed_get_intensity(&sledges[si], &at_origin, &at_next_stop);
-            hsl_t led_col;
-            lerp_hsl(&black, &tail[0], at_next_stop, &led_col);
-            ledstrip->channel[0].leds[sledges[si].next_stop] = hsl2rgb(&led_col);
-            for (int i = 1; i < (int)tail_len + 1; ++i)
-            {
-                lerp_hsl(&tail[i - 1], &tail[i], at_next_stop, &led_col);
-                ledstrip->channel[0].leds[sledges[si].next_stop + i] = hsl2rgb(&led_col);
-            }
-        }
+        float tail_len = 1 + particles.speed[si] / 2.0f;
+        if ((int)tail_len >= C_TAIL_MAX) tail_len = C_TAIL_MAX - 1;
+        particles.behind[si] = tail_len;
     }
+    Particles_render(&particles, &geometry, ledstrip->channel[0].leds);
 }
 
 
@@ -1096,6 +1030,69 @@ static int update_leds_valeria(ws2811_t* ledstrip)
 
 #pragma endregion
 
+#pragma region Ripples
+
+#define RIPPLES_MAX     8
+#define RIPPLE_WIDTH    3.0f    //in geometry distance units
+
+typedef struct Ripple {
+    int origin;             // -1 if the ripple is not active
+    unsigned long start;    // in ms
+    ws2811_led_t color;
+} ripple_t;
+
+static ripple_t ripples[RIPPLES_MAX];
+
+static void Ripples_init()
+{
+    for (int ri = 0; ri < RIPPLES_MAX; ++ri)
+        ripples[ri].origin = -1;
+}
+
+/*!
+ * @brief Rings spread from random LEDs over the whole tree. The distance field of the origin is built the
+ *        first time it is picked, then every frame is just a lookup per LED
+ */
+static int update_leds_ripples(ws2811_t* ledstrip)
+{
+    ws2811_led_t* leds = ledstrip->channel[0].leds;
+    for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
+        leds[led] = 0;
+    unsigned long now = current_time_in_ms();
+    for (int ri = 0; ri < RIPPLES_MAX; ++ri)
+    {
+        if (ripples[ri].origin == -1)
+        {
+            if (random_01() < config.ripple_chance)
+            {
+                ripples[ri].origin = (int)(random_01() * xmas_source.basic_source.n_leds);
+                ripples[ri].start = now;
+                ripples[ri].color = xmas_source.basic_source.gradient.colors[XMAS_GRAD_START + (int)(random_01() * XMAS_GRAD_LEN)];
+            }
+            continue;
+        }
+        const geometry_field_t* field = Geometry_field(&geometry, ripples[ri].origin);
+        float radius = config.ripple_speed * (float)(now - ripples[ri].start) / 1000.0f;
+        if (radius - RIPPLE_WIDTH > field->max_distance)
+        {
+            ripples[ri].origin = -1;
+            continue;
+        }
+        //the wave front is at `radius`, it fades out towards the origin
+        float fade = 1.0f - radius / (field->max_distance + RIPPLE_WIDTH);
+        for (int led = 0; led < xmas_source.basic_source.n_leds; ++led)
+        {
+            float behind = radius - field->distance[led];
+            if (behind < 0 || behind >= RIPPLE_WIDTH) //unreachable LEDs are always far ahead
+                continue;
+            leds[led] = multiply_rgb_color(ripples[ri].color, fade * (1.0f - behind / RIPPLE_WIDTH));
+        }
+    }
+    return 1;
+}
+
+#pragma endregion
+
 #pragma region XmasSource
 
 static int update_leds_debug(ws2811_t* ledstrip)
@@ -1137,9 +1134,111 @@ XMAS_MODE_t string_to_xmas_mode(const char* txt)
         return XM_SLEDGES;
     if (strcasecmp(txt, "valeria") == 0)
         return XM_VALERIA;
+    if (strcasecmp(txt, "ripples") == 0)
+        return XM_RIPPLES;
     return N_XMAS_MODES;
 }
 
+static int mode_prepared[N_XMAS_MODES];                 //!< modes whose state is allocated, it is kept across switches
+static XMAS_MODE_t next_random_mode = N_XMAS_MODES;     //!< the random rotation picks its next mode in advance
+static XMAS_MODE_t mode_to_warm = N_XMAS_MODES;         //!< mode to prepare in the next frame, N_XMAS_MODES for none
+
+#define XMAS_PLAYLIST_MAX 64
+
+typedef struct PlaylistEntry
+{
+    XMAS_MODE_t mode;
+    unsigned long duration;     //!< in ms, the fade is included
+    unsigned long fade;         //!< crossfade from the previous entry in ms, 0 for a cut
+} playlist_entry_t;
+
+static struct
+{
+    playlist_entry_t entries[XMAS_PLAYLIST_MAX];
+    int n;
+    int current;                //!< -1 when the playlist is not playing
+    int is_started;             //!< 0 until the current entry is shown, it starts in the next frame
+    unsigned long entry_start;  //!< in ms
+} playlist = { .current = -1 };
+
+static ws2811_led_t* fade_from;     //!< last frame of the previous mode, the new one fades in over it
+static ws2811_t mode_strip;         //!< the new mode draws here during a fade, it keeps its own frame
+static unsigned long fade_length;   //!< in ms, 0 when there is no fade
+
+/*!
+ * @brief Append entries to the playlist, e.g. "glitter 300 5, snowflakes 600 2.5, fireworks 120",
+ *        i.e. mode, duration in seconds and an optional crossfade in seconds from the previous entry
+ * @returns 1 on success, 0 when an entry cannot be read, the entries before it are kept
+ */
+static int Playlist_parse(const char* text)
+{
+    while (*text)
+    {
+        char name[32];
+        float duration, fade = 0;
+        int offset = 0;
+        int n = sscanf(text, " %31[^ ,] %f %f%n", name, &duration, &fade, &offset);
+        if (n == 2)
+            n = sscanf(text, " %31[^ ,] %f%n", name, &duration, &offset);
+        XMAS_MODE_t mode = (n >= 2) ? string_to_xmas_mode(name) : N_XMAS_MODES;
+        if (mode == N_XMAS_MODES || duration <= 0 || fade < 0)
+        {
+            printf("Cannot read playlist entry: %s\n", text);
+            return 0;
+        }
+        if (playlist.n == XMAS_PLAYLIST_MAX)
+        {
+            printf("Playlist is full, only %i entries fit\n", XMAS_PLAYLIST_MAX);
+            return 0;
+        }
+        playlist_entry_t* entry = &playlist.entries[playlist.n++];
+        entry->mode = mode;
+        entry->duration = (unsigned long)(duration * 1000);
+        entry->fade = (fade > duration) ? entry->duration : (unsigned long)(fade * 1000);
+        text += offset;
+        while (*text == ' ' || *text == ',')
+            text++;
+    }
+    return 1;
+}
+
+static void XmasSource_switch_mode(XMAS_MODE_t mode);
+
+/*! @brief Play from `entry`, it is shown from the next frame */
+static void Playlist_play(int entry)
+{
+    playlist.current = entry;
+    playlist.is_started = 0;
+}
+
+/*!
+ * @brief Move to the next entry when the current one is over. The mode after it is known in advance,
+ *        it is prepared in the next frame
+ * @returns 1 if the mode was switched in this frame
+ */
+static int Playlist_update(ws2811_t* ledstrip)
+{
+    unsigned long now = current_time_in_ms();
+    if (playlist.is_started && now - playlist.entry_start < playlist.entries[playlist.current].duration)
+        return 0;
+    if (playlist.is_started)
+        playlist.current = (playlist.current + 1) % playlist.n;
+    const playlist_entry_t* entry = &playlist.entries[playlist.current];
+    int n_leds = xmas_source.basic_source.n_leds;
+    XmasSource_switch_mode(entry->mode);
+    if (entry->fade > 0)
+    {
+        memcpy(fade_from, ledstrip->channel[0].leds, sizeof(ws2811_led_t) * n_leds);
+        memcpy(mode_strip.channel[0].leds, fade_from, sizeof(ws2811_led_t) * n_leds);
+        fade_length = entry->fade;
+    }
+    playlist.is_started = 1;
+    playlist.entry_start = now;
+    mode_to_warm = playlist.entries[(playlist.current + 1) % playlist.n].mode;
+    printf("Playlist entry %i in XmasSource, mode: %i\n", playlist.current, entry->mode);
+    return 1;
+}
+
 int XmasSource_process_config(const char* name, const char* value)
 {
     if (strcasecmp(name, "n_snowflakes") == 0) {
@@ -1322,19 +1421,27 @@ int XmasSource_process_config(const char* name, const char* value)
         config.valeria_speed = strtof(value, NULL);
         return 1;
     }
+    //ripples
+    if (strcasecmp(name, "ripple_speed") == 0) {
+        config.ripple_speed = strtof(value, NULL);
+        return 1;
+    }
+    if (strcasecmp(name, "ripple_chance") == 0) {
+        config.ripple_chance = strtof(value, NULL);
+        return 1;
+    }
+    if (strcasecmp(name, "playlist") == 0) {
+        return Playlist_parse(value);
+    }
     printf("Unknown config option %s with value %s\n", name, value);
     return 0;
 }
 
 static void random_mode();
+static void XmasSource_prepare_mode(XMAS_MODE_t mode);
 
-//returns 1 if leds were updated, 0 if update is not necessary
-int XmasSource_update_leds(int frame, ws2811_t* ledstrip)
+static int XmasSource_update_mode(int frame, ws2811_t* ledstrip)
 {
-    if (config.is_random && current_time_in_ms() - random_time_start > 300000l)
-    {
-        random_mode();
-    }
     switch (xmas_source.mode)
     {
     case XM_SNOWFLAKES:
@@ -1357,6 +1464,8 @@ int XmasSource_update_leds(int frame, ws2811_t* ledstrip)
         return update_leds_sledges(ledstrip);
     case XM_VALERIA:
         return update_leds_valeria(ledstrip);
+    case XM_RIPPLES:
+        return update_leds_ripples(ledstrip);
     case N_XMAS_MODES:
         printf("Invalid Xmas Source Mode in frame %d\n", frame);
         break;
@@ -1364,48 +1473,147 @@ int XmasSource_update_leds(int frame, ws2811_t* ledstrip)
     return 0;
 }
 
-void XmasSource_destruct_current_mode()
+/*! @brief The new mode is drawn on its own and mixed over the last frame of the old one */
+static int XmasSource_update_fade(int frame, ws2811_t* ledstrip)
 {
-    switch (xmas_source.mode)
+    int n_leds = xmas_source.basic_source.n_leds;
+    ws2811_led_t* leds = ledstrip->channel[0].leds;
+    XmasSource_update_mode(frame, &mode_strip);
+    unsigned long elapsed = current_time_in_ms() - playlist.entry_start;
+    if (elapsed >= fade_length)
+    {
+        //the mode carries on in the real strip, some modes only redraw what changed
+        memcpy(leds, mode_strip.channel[0].leds, sizeof(ws2811_led_t) * n_leds);
+        fade_length = 0;
+        return 1;
+    }
+    double t = (double)elapsed / (double)fade_length;
+    for (int led = 0; led < n_leds; ++led)
+    {
+        leds[led] = mix_rgb_color(mode_strip.channel[0].leds[led], fade_from[led], t);
+    }
+    return 1;
+}
+
+//returns 1 if leds were updated, 0 if update is not necessary
+int XmasSource_update_leds(int frame, ws2811_t* ledstrip)
+{
+    int switched = 0;
+    if (playlist.current != -1)
+    {
+        switched = Playlist_update(ledstrip);
+    }
+    else if (config.is_random && current_time_in_ms() - random_time_start > 300000l)
+    {
+        random_mode();
+        switched = 1;
+    }
+    if (!switched && mode_to_warm != N_XMAS_MODES)
     {
+        //never in the frame of a switch, that one only restarts the new mode
+        XmasSource_prepare_mode(mode_to_warm);
+        mode_to_warm = N_XMAS_MODES;
+    }
+    if (fade_length > 0)
+    {
+        return XmasSource_update_fade(frame, ledstrip);
+    }
+    return XmasSource_update_mode(frame, ledstrip);
+}
+
+/*! @brief The expensive part of the mode init, allocations and palettes. It runs once, the state is kept across switches */
+static void XmasSource_prepare_mode(XMAS_MODE_t mode)
+{
+    if (mode == N_XMAS_MODES || mode_prepared[mode])
+        return;
+    switch (mode)
+    {
+    case XM_GLITTER:
+        if (!Glitter1_prepare())
+            return;
+        break;
+    case XM_GLITTER2:
+        if (!Glitter2_prepare())
+            return;
+        break;
+    case XM_ICICLES:
+        if (!Icicles_prepare())
+            return;
+        break;
+    case XM_SNOWFLAKES:
+        if (!Snowflakes_prepare())
+            return;
+        break;
+    case XM_GRADIENT:
+    case XM_JOY_PATTERN:
+        Gradient_prepare();
+        break;
+    case XM_GRADIENT2:
+        Gradient2_prepare();
+        break;
+    case XM_FIREWORKS:
+        Fireworks_prepare();
+        break;
     case XM_DEBUG:
+    case XM_SLEDGES:
+    case XM_VALERIA:
+    case XM_RIPPLES:
+    case N_XMAS_MODES:
         break;
+    }
+    mode_prepared[mode] = 1;
+}
+
+static void XmasSource_release_mode(XMAS_MODE_t mode)
+{
+    if (!mode_prepared[mode])
+        return;
+    switch (mode)
+    {
     case XM_GLITTER:
+        Glitter_destruct(&glitter_states[0]);
+        break;
     case XM_GLITTER2:
-        Glitter_destruct();
+        Glitter_destruct(&glitter_states[1]);
         break;
     case XM_ICICLES:
-        free(icicle_colors);
-        free(icicles);
+        free(icicle_ramps);
         break;
     case XM_SNOWFLAKES:
-        free(snowflakes);
-        free(diff_data);
-        free(spec_data);
+        Snowflakes_destruct();
         break;
     case XM_FIREWORKS:
         free(static_flares);
+        break;
+    case XM_DEBUG:
     case XM_GRADIENT:
     case XM_GRADIENT2:
     case XM_JOY_PATTERN:
     case XM_SLEDGES:
     case XM_VALERIA:
-        break;
+    case XM_RIPPLES:
     case N_XMAS_MODES:
         break;
     }
+    mode_prepared[mode] = 0;
 }
 
 void XmasSource_destruct()
 {
-    XmasSource_destruct_current_mode();
-    free(geometry.neighbors);
-    free(geometry.heads);
-    free(geometry.springs);
+    for (int mode = 0; mode < N_XMAS_MODES; ++mode)
+    {
+        XmasSource_release_mode((XMAS_MODE_t)mode);
+    }
+    Particles_free(&particles);
+    Geometry_free(&geometry);
+    free(fade_from);
+    free(mode_strip.channel[0].leds);
 }
 
+/*! @brief (Re)start the current mode, only the cheap part runs when the mode has been prepared before */
 void XmasSource_init_current_mode()
 {
+    XmasSource_prepare_mode(xmas_source.mode);
     switch (xmas_source.mode)
     {
     case XM_DEBUG:
@@ -1440,21 +1648,38 @@ void XmasSource_init_current_mode()
     case XM_VALERIA:
         Valeria_init();
         break;
+    case XM_RIPPLES:
+        Ripples_init();
+        break;
     case N_XMAS_MODES:
         break;
     }
 }
 
-static void random_mode()
+static void XmasSource_switch_mode(XMAS_MODE_t mode)
 {
-    int mode = 1 + random_01() * (N_XMAS_MODES - 1); //mode 0 is debug, not very interesting
-    XmasSource_destruct_current_mode();
-    xmas_source.mode = (XMAS_MODE_t)mode;
+    fade_length = 0;
+    xmas_source.mode = mode;
     XmasSource_init_current_mode();
     xmas_source.first_update = 0;
+}
+
+static XMAS_MODE_t pick_random_mode()
+{
+    return (XMAS_MODE_t)(1 + random_01() * (N_XMAS_MODES - 1)); //mode 0 is debug, not very interesting
+}
+
+static void random_mode()
+{
+    XMAS_MODE_t mode = (next_random_mode != N_XMAS_MODES) ? next_random_mode : pick_random_mode();
+    playlist.current = -1;
+    XmasSource_switch_mode(mode);
     printf("Switched random mode in XmasSource to: %i\n", mode);
     config.is_random = 1;
     random_time_start = current_time_in_ms();
+    //the mode after this one is known already, it is prepared in the next frame so that the next switch is only a restart
+    next_random_mode = pick_random_mode();
+    mode_to_warm = next_random_mode;
 }
 
 // The whole message is e.g. LED MSG MODE?GLITTER
@@ -1492,13 +1717,31 @@ void XmasSource_process_message(const char* msg)
             random_mode();
             return;
         }
-        XmasSource_destruct_current_mode();
-        xmas_source.mode = mode;
-        XmasSource_init_current_mode();
-        xmas_source.first_update = 0;
+        playlist.current = -1;
+        XmasSource_switch_mode(mode);
         printf("Switched mode in XmasSource to: %s\n", payload);
         config.is_random = 0;
     }
+    else if (!strncasecmp(target, "PLAYLIST_ADD", 12))
+    {
+        Playlist_parse(payload);
+        if (playlist.current == -1 && playlist.n > 0)
+        {
+            config.is_random = 0;
+            Playlist_play(0);
+        }
+    }
+    else if (!strncasecmp(target, "PLAYLIST", 8))
+    {
+        playlist.n = 0;
+        playlist.current = -1;
+        if (Playlist_parse(payload) && playlist.n > 0)
+        {
+            config.is_random = 0;
+            Playlist_play(0);
+            printf("New playlist in XmasSource with %i entries\n", playlist.n);
+        }
+    }
     else if (!strncasecmp(target, "DEBUG", 5))
     {
         xmas_source.led_index = atoi(payload);
@@ -1515,6 +1758,25 @@ void XmasSource_init(int n_leds, int time_speed, uint64_t current_time)
     xmas_source.mode = XM_GLITTER;
     xmas_source.first_update = 0;
     XmasSource_read_geometry();
+    if (!Particles_init(&particles, (n_leds > XMAS_PARTICLES_MIN) ? n_leds : XMAS_PARTICLES_MIN))
+    {
+        printf("Cannot allocate memory for particles\n");
+        exit(-4);
+    }
+    fade_from = malloc(sizeof(ws2811_led_t) * n_leds);
+    mode_strip.channel[0].count = n_leds;
+    mode_strip.channel[0].leds = calloc(n_leds, sizeof(ws2811_led_t));
+    if (!fade_from || !mode_strip.channel[0].leds)
+    {
+        printf("Cannot allocate memory for mode fades\n");
+        exit(-4);
+    }
+    if (playlist.n > 0)
+    {
+        //the first entry fades in from black in the first frame
+        xmas_source.mode = playlist.entries[0].mode;
+        Playlist_play(0);
+    }
     XmasSource_init_current_mode();
 }
 
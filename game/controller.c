@@ -18,6 +18,7 @@
 #endif
 
 #include "controller.h"
+#include "replay.h"
 
 static int input[C_MAX_CONTROLLERS];
 static int n_players;
@@ -139,7 +140,7 @@ int Controller_get_n_players(void)
     return n_players;
 }
 
-void Controller_init(void)
+static void init_controllers(void)
 {
     for (int i = 0; i < C_MAX_CONTROLLERS; i++)
     {
@@ -171,6 +172,23 @@ void Controller_init(void)
     n_players = C_MAX_CONTROLLERS;
 }
 
+void Controller_init(void)
+{
+    switch (Replay_get_mode())
+    {
+    case RM_PLAY:
+        n_players = Replay_read_players();
+        break;
+    case RM_RECORD:
+        init_controllers();
+        Replay_write_players(n_players);
+        break;
+    case RM_OFF:
+        init_controllers();
+        break;
+    }
+}
+
 void process_d_pad(enum EButtons* button, enum EState* state, int value, enum EButtons neg_value, enum EButtons pos_value)
 {
     if (value == 0)
@@ -186,7 +204,7 @@ void process_d_pad(enum EButtons* button, enum EState* state, int value, enum EB
     }
 }
 
-int Controller_get_button(uint64_t t, enum EButtons* button, enum EState* state, int controller_index)
+static int read_button(uint64_t t, enum EButtons* button, enum EState* state, int controller_index)
 {
     assert(controller_index < n_players);
 #ifndef __linux__
@@ -252,3 +270,31 @@ update:
     button_states[controller_index][*button] = (*state == BT_pressed) ? t : 0;
     return 1;
 }
+
+int Controller_get_button(uint64_t t, enum EButtons* button, enum EState* state, int controller_index)
+{
+    int i;
+    switch (Replay_get_mode())
+    {
+    case RM_PLAY:
+    {
+        int recorded_button, recorded_state;
+        i = Replay_read_button(controller_index, &recorded_button, &recorded_state);
+        if (i)
+        {
+            *button = recorded_button;
+            *state = recorded_state;
+        }
+        return i;
+    }
+    case RM_RECORD:
+        i = read_button(t, button, state, controller_index);
+        if (i > 0)
+            Replay_write_button(controller_index, i, *button, *state);
+        else
+            Replay_write_button(controller_index, i, 0, 0); //nothing was read, button and state are not set
+        return i;
+    default:
+        return read_button(t, button, state, controller_index);
+    }
+}
@@ -15,6 +15,9 @@
 #else
 #include "fakeled.h"
 #endif // __linux__
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include "common_source.h"
 #include "colours.h"
@@ -45,14 +48,33 @@ char win_messages[GM_PLAYER_LOST][16] = {
 };
 
 
-typedef struct GameObject
+/*! Range of object indices that are handed out by `get_free_index` */
+typedef struct ObjectPool
 {
-    enum StencilFlags stencil_flag;
-    int health;
-    int deleted;
-    int mark;           //!< bit array: 0: used by stencil; 1,2,3: colors RGB; 
-    uint64_t time;
-} game_object_t;
+    int min;
+    int max;            //!< exclusive
+} object_pool_t;
+
+/*!
+ * Entity store, every column is indexed by the object index. Moving and pulse objects keep their own columns
+ * under the same index. The live objects are also listed in ascending order so that the frame loops touch
+ * only them, in the same order as a scan of all indices would
+ */
+static struct
+{
+    uint8_t stencil_flag[MAX_N_OBJECTS];    //!< enum StencilFlags
+    uint8_t deleted[MAX_N_OBJECTS];
+    uint16_t generation[MAX_N_OBJECTS];     //!< bumped every time the slot gets a new object, 0 is never used
+    int health[MAX_N_OBJECTS];
+    int mark[MAX_N_OBJECTS];                //!< bit array: 0: used by stencil; 1,2,3: colors RGB; 
+    uint64_t time[MAX_N_OBJECTS];
+    uint32_t free_mask[MAX_N_OBJECTS / 32]; //!< bit set for every slot of a pool that can be handed out
+    int16_t live[MAX_N_OBJECTS];            //!< indices of live objects, ascending
+    int n_live;
+} objects;
+
+static object_pool_t background_pool;
+static object_pool_t projectile_pool;
 
 static struct
 {
@@ -63,34 +85,100 @@ static struct
     uint64_t confetti_thrown;
 } boss;
 
-static game_object_t game_objects[MAX_N_OBJECTS];
 static enum GameModes current_mode = GM_LEVEL1;
 static enum GameModes next_mode = GM_LEVEL1; //<! flag to be set when the mode is changed in the next update
 static enum GameModes prev_mode = GM_LEVEL1;
 
-static int get_free_index(int min, int max, char* error_message)
+#ifdef _MSC_VER
+static int lowest_bit(uint32_t word)
 {
-    int i = min;
-    while (i < max && !game_objects[i].deleted)
-    {
-        i++;
-    }
-    if (i >= max)
+    unsigned long bit;
+    _BitScanForward(&bit, word);
+    return (int)bit;
+}
+#else
+static int lowest_bit(uint32_t word)
+{
+    return __builtin_ctz(word);
+}
+#endif
+
+static int is_pooled(int gi)
+{
+    return (gi >= background_pool.min && gi < background_pool.max) ||
+        (gi >= projectile_pool.min && gi < projectile_pool.max);
+}
+
+static void push_free(int gi)
+{
+    if (is_pooled(gi))
+        objects.free_mask[gi / 32] |= 1u << (gi % 32);
+}
+
+static void unlink_free(int gi)
+{
+    objects.free_mask[gi / 32] &= ~(1u << (gi % 32));
+}
+
+static void pool_init(object_pool_t* pool, int min, int max)
+{
+    pool->min = min;
+    pool->max = max;
+    for (int gi = min; gi < max; ++gi)
+        push_free(gi);
+}
+
+/*!
+ * @brief Take the lowest free slot of the pool, only the few words of the mask that cover the pool are looked at
+ * @returns index of the slot, it stays deleted until `GameObject_init` is called, -1 when the pool is full
+ */
+static int get_free_index(object_pool_t* pool, char* error_message)
+{
+    int last = pool->max - 1;
+    for (int w = pool->min / 32; w <= last / 32; ++w)
     {
-        printf(error_message);
-        return -1;
+        uint32_t word = objects.free_mask[w];
+        if (w == pool->min / 32)
+            word &= ~0u << (pool->min % 32);
+        if (w == last / 32)
+            word &= ~0u >> (31 - last % 32);
+        if (word)
+        {
+            int i = w * 32 + lowest_bit(word);
+            unlink_free(i);
+            return i;
+        }
     }
-    return i;
+    printf(error_message);
+    return -1;
 }
 
 int GameObject_new_projectile_index()
 {
-    return get_free_index(C_PROJCT_OBJ_INDEX, MAX_N_OBJECTS, "Failed to find a free projectile index\n");
+    return get_free_index(&projectile_pool, "Failed to find a free projectile index\n");
 }
 
 int GameObject_new_background_index()
 {
-    return get_free_index(C_BKGRND_OBJ_INDEX, C_OBJECT_OBJ_INDEX, "Failed to find a free background index\n");
+    return get_free_index(&background_pool, "Failed to find a free background index\n");
+}
+
+void* GameObject_reserve_column(void* column, int* capacity, int needed, size_t item_size)
+{
+    if (needed <= *capacity)
+        return column;
+    int new_capacity = (*capacity < 4) ? 4 : *capacity;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+    char* grown = realloc(column, item_size * new_capacity);
+    if (grown == NULL)
+    {
+        printf("Failed to allocate %i items of object data\n", new_capacity);
+        exit(-4);
+    }
+    memset(grown + item_size * *capacity, 0, item_size * (new_capacity - *capacity));
+    *capacity = new_capacity;
+    return grown;
 }
 
 
@@ -113,17 +201,17 @@ static int GameObject_spawn_enemy_projectile(int color_index, double pos, enum M
 */
 int GameObject_resolve_projectile_collision(int bullet1, int bullet2)
 {
-    if ((game_objects[bullet1].stencil_flag) == (game_objects[bullet2].stencil_flag)) //either two player's bullets or two enemy bullets
+    if ((objects.stencil_flag[bullet1]) == (objects.stencil_flag[bullet2])) //either two player's bullets or two enemy bullets
         return 0;
-    if ((game_objects[bullet1].mark & 14) == (game_objects[bullet2].mark & 14))  //they have the same colour
+    if ((objects.mark[bullet1] & 14) == (objects.mark[bullet2] & 14))  //they have the same colour
         return 3;
-    if (game_objects[bullet1].mark & 2) //R
-        return (game_objects[bullet2].mark & 4) == 4 ? 1 : 2;
-    if (game_objects[bullet1].mark & 4) //G
-        return (game_objects[bullet2].mark & 8) == 8 ? 1 : 2;
-    if (game_objects[bullet1].mark & 8) //B
-        return (game_objects[bullet2].mark & 2) == 2 ? 1 : 2;
-    printf("B1: %i, B2: %i\n", game_objects[bullet1].mark, game_objects[bullet2].mark);
+    if (objects.mark[bullet1] & 2) //R
+        return (objects.mark[bullet2] & 4) == 4 ? 1 : 2;
+    if (objects.mark[bullet1] & 4) //G
+        return (objects.mark[bullet2] & 8) == 8 ? 1 : 2;
+    if (objects.mark[bullet1] & 8) //B
+        return (objects.mark[bullet2] & 2) == 2 ? 1 : 2;
+    printf("B1: %i, B2: %i\n", objects.mark[bullet1], objects.mark[bullet2]);
     assert(0);
     return -1; //this should never happen
 }
@@ -172,7 +260,7 @@ static void update_objects_level1()
         double stargate_centre = MovingObject_get_position(0) + MovingObject_get_length(0) / 2;
         int bullet = GameObject_spawn_enemy_projectile(config.color_index_G, stargate_centre, MO_FORWARD, 1);
         assert(bullet >= 0);
-        game_objects[bullet].mark = 4;
+        objects.mark[bullet] = 4;
     }
     PlayerObject_update();
     update_stargate(0.1);  //one shrink on average every ten seconds
@@ -187,7 +275,7 @@ static void update_objects_level2()
         double stargate_centre = MovingObject_get_position(0) + MovingObject_get_length(0) / 2;
         int bullet = GameObject_spawn_enemy_projectile(color_index, stargate_centre, MO_FORWARD, 1);
         assert(bullet >= 0);
-        game_objects[bullet].mark = 2 << level; //bit 0 is used by stencil; this is really not a very good system
+        objects.mark[bullet] = 2 << level; //bit 0 is used by stencil; this is really not a very good system
     }
     PlayerObject_update();
     update_stargate(0.15);
@@ -203,7 +291,7 @@ static void update_objects_level3()
         int bullet = GameObject_spawn_enemy_projectile(color_index, stargate_centre, MO_FORWARD, 1);
         assert(bullet >= 0);
         //level 0 = C = 4 + 8; 1 = M = 2 + 8; 2 = Y = 2 + 4
-        game_objects[bullet].mark = 14 ^ (2 << level);
+        objects.mark[bullet] = 14 ^ (2 << level);
     }
     PlayerObject_update();
     update_stargate(0.15);
@@ -217,7 +305,7 @@ static void GameObjects_ready_special_attack(int i)
 
 static void boss_special_attack_bullet(int i)
 {
-    game_objects[i].stencil_flag = SF_EnemyProjectile;
+    objects.stencil_flag[i] = SF_EnemyProjectile;
 }
 
 static void boss_special_attack()
@@ -253,7 +341,7 @@ static void update_objects_level_boss()
         int bullet = GameObject_spawn_enemy_projectile(color_index, boss_end_pos, f, (pos < config.wraparound_fire_pos));
         if (bullet != -1)
         {
-            game_objects[bullet].mark = 2 << level;
+            objects.mark[bullet] = 2 << level;
         }
     }
     if (MovingObject_get_speed(C_OBJECT_OBJ_INDEX) == 0 && roll_dice_poisson(2))
@@ -381,63 +469,96 @@ static void GameObject_update_objects()
     }
 }
 
+object_handle_t GameObject_handle(int gi)
+{
+    return ((object_handle_t)objects.generation[gi] << 16) | (object_handle_t)gi;
+}
+
+int GameObject_resolve(object_handle_t handle)
+{
+    int gi = handle & 0xFFFF;
+    if (gi >= MAX_N_OBJECTS || objects.deleted[gi] || objects.generation[gi] != handle >> 16)
+        return -1;
+    return gi;
+}
+
 void GameObject_delete_object(int gi)
 {
-    game_objects[gi].deleted = 1;
+    if (objects.deleted[gi])
+        return;
+    objects.deleted[gi] = 1;
+    int l = 0;
+    while (objects.live[l] != gi)
+        l++;
+    memmove(objects.live + l, objects.live + l + 1, sizeof(int16_t) * (objects.n_live - l - 1));
+    objects.n_live--;
+    push_free(gi);
 }
 
 int GameObject_is_deleted(int gi)
 {
-    return game_objects[gi].deleted;
+    return objects.deleted[gi];
 }
 
 void GameObject_init(int gi, int health, int stencil_flag)
 {
-    game_objects[gi].deleted = 0;
-    game_objects[gi].health = health;
-    game_objects[gi].stencil_flag = stencil_flag;
-    game_objects[gi].mark = 0;
-    game_objects[gi].time = game_source.basic_source.current_time;
+    if (objects.deleted[gi])
+    {
+        unlink_free(gi);
+        int l = objects.n_live;
+        while (l > 0 && objects.live[l - 1] > gi)
+            l--;
+        memmove(objects.live + l + 1, objects.live + l, sizeof(int16_t) * (objects.n_live - l));
+        objects.live[l] = gi;
+        objects.n_live++;
+        objects.deleted[gi] = 0;
+        if (++objects.generation[gi] == 0)
+            objects.generation[gi] = 1;
+    }
+    objects.health[gi] = health;
+    objects.stencil_flag[gi] = stencil_flag;
+    objects.mark[gi] = 0;
+    objects.time[gi] = game_source.basic_source.current_time;
 }
 
 int GameObject_take_hit(int gi)
 {
-    return --game_objects[gi].health;
+    return --objects.health[gi];
 }
 
 int GameObject_heal(int gi)
 {
-    return ++game_objects[gi].health;
+    return ++objects.health[gi];
 }
 
 int GameObject_get_health(int gi)
 {
-    return game_objects[gi].health;
+    return objects.health[gi];
 }
 
 void GameObject_mark(int gi, int mark)
 {
-    game_objects[gi].mark |= mark;
+    objects.mark[gi] |= mark;
 }
 
 void GameObject_clear_mark(int gi, int mark)
 {
-    game_objects[gi].mark &= (0xFFFFFF - mark);
+    objects.mark[gi] &= (0xFFFFFF - mark);
 }
 
 int GameObject_get_mark(int gi)
 {
-    return game_objects[gi].mark;
+    return objects.mark[gi];
 }
 
 uint64_t GameObject_get_time(int gi)
 {
-    return game_objects[gi].time;
+    return objects.time[gi];
 }
 
 enum StencilFlags GameObject_get_stencil_flag(int gi)
 {
-    return game_objects[gi].stencil_flag;
+    return objects.stencil_flag[gi];
 }
 
 //******** GAME STATE FUNCTIONS ********
@@ -608,14 +729,25 @@ static void GameObjects_init_objects()
 void GameObjects_init()
 {
     for (int i = 0; i < MAX_N_OBJECTS; ++i)
-        game_objects[i].deleted = 1;
+        objects.deleted[i] = 1;
+    objects.n_live = 0;
+    memset(objects.free_mask, 0, sizeof(objects.free_mask));
+    pool_init(&background_pool, C_BKGRND_OBJ_INDEX, C_OBJECT_OBJ_INDEX);
+    pool_init(&projectile_pool, C_PROJCT_OBJ_INDEX, MAX_N_OBJECTS);
 
+    PulseObject_clear_ramps();
     PlayerObject_init(current_mode);
     InputHandler_init(current_mode);
     Stencil_init(current_mode);
     GameObjects_init_objects();
 }
 
+void GameObjects_destruct()
+{
+    MovingObject_free_all();
+    PulseObject_free_all();
+}
+
 enum GameModes GameObjects_get_current_mode()
 {
     return current_mode;
@@ -646,8 +778,8 @@ static void GameObjects_shrink_boss(int i)
 void GameObjects_boss_hit(int i)
 {
     assert(i == C_OBJECT_OBJ_INDEX);
-    game_objects[C_OBJECT_OBJ_INDEX].health--;
-    if (!game_objects[C_OBJECT_OBJ_INDEX].health)
+    objects.health[C_OBJECT_OBJ_INDEX]--;
+    if (!objects.health[C_OBJECT_OBJ_INDEX])
     {
         next_mode = current_mode + 1;
         printf("Boss defeated\n");
@@ -674,7 +806,7 @@ void GameObjects_next_level()
 {
     //there is a timeout after winning previous level during which we can proceed
     const uint64_t timeout = 2 * 1e9;
-    if (game_source.basic_source.current_time - game_objects[0].time < timeout) return;
+    if (game_source.basic_source.current_time - objects.time[0] < timeout) return;
     if (current_mode != GM_PLAYER_LOST)
     {
         next_mode = current_mode + 1;
@@ -723,26 +855,38 @@ int GameObjects_update_leds(int frame, ws2811_t* ledstrip)
 
     //unit_tests();
     Canvas_clear(ledstrip->channel[0].leds);
+    Stencil_clear();
     InputHandler_process_input();
     GameObject_update_objects();
+    //objects can be deleted by the callbacks below, so walk a copy of the live list
+    int16_t live[MAX_N_OBJECTS];
+    int n_live = objects.n_live;
+    memcpy(live, objects.live, sizeof(int16_t) * n_live);
     //calculate movement, check collisions, adjust movement, start effects
-    for (int gi = 0; gi < MAX_N_OBJECTS; ++gi)
+    for (int l = 0; l < n_live; ++l)
     {
-        if (game_objects[gi].deleted)
+        int gi = live[l];
+        if (objects.deleted[gi])
         {
             continue;
         }
         MovingObject_calculate_move_results(gi);
-        Stencil_stencil_test(gi, game_objects[gi].stencil_flag);
+        Stencil_stencil_test(gi, objects.stencil_flag[gi]);
     }
-    //apply movement results, render scene
-    for (int gi = 0; gi < MAX_N_OBJECTS; ++gi)
+    //objects deleted by their own pulse callbacks are still drawn in this frame
+    int n_active = 0;
+    for (int l = 0; l < n_live; ++l)
     {
-        if (game_objects[gi].deleted)
+        if (!objects.deleted[live[l]])
         {
-            continue;
+            live[n_active++] = live[l];
         }
-        PulseObject_update(gi);
+    }
+    PulseObject_update_all(live, n_active);
+    //apply movement results, render scene
+    for (int l = 0; l < n_active; ++l)
+    {
+        int gi = live[l];
         MovingObject_render(gi, ledstrip->channel[0].leds);
         MovingObject_update(gi);
     }
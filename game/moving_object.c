@@ -34,7 +34,8 @@ typedef struct MovingObject
     uint32_t target;
     enum MovingObjectFacing facing;
     enum ZdepthIndex zdepth;
-    ws2811_led_t color[MAX_OBJECT_LENGTH];  //!< must be initialized with `length` colors, color[0] is tail, color[length-1] is head, regardless of `facing`
+    ws2811_led_t* color;    //!< must be initialized with `length` colors, color[0] is tail, color[length-1] is head, regardless of `facing`
+    int color_capacity;     //!< the colours only grow, the slot keeps them for the next object
     int render_type;    //!< 0: render antialiased, 1: render with trail (and antialiased), 2: render aligned
     void(*on_arrival)(int);
 } moving_object_t;
@@ -63,8 +64,6 @@ void Canvas_clear(ws2811_led_t* leds)
     for (int i = 0; i < game_source.basic_source.n_leds; i++)
     {
         canvas[i].zbuffer = 999;
-        canvas[i].stencil = -1;
-        canvas[i].object_index = -1;
         leds[i] = 0;
     }
 }
@@ -73,6 +72,7 @@ void MovingObject_init_stopped(int mi, double position, enum MovingObjectFacing
 {
     assert(length <= MAX_OBJECT_LENGTH);
     moving_object_t* object = &moving_objects[mi];
+    object->color = GameObject_reserve_column(object->color, &object->color_capacity, length, sizeof(ws2811_led_t));
     object->index = mi;
     object->position = position;
     object->facing = facing;
@@ -84,6 +84,16 @@ void MovingObject_init_stopped(int mi, double position, enum MovingObjectFacing
     object->on_arrival = NULL;
 }
 
+void MovingObject_free_all()
+{
+    for (int mi = 0; mi < MAX_N_OBJECTS; ++mi)
+    {
+        free(moving_objects[mi].color);
+        moving_objects[mi].color = NULL;
+        moving_objects[mi].color_capacity = 0;
+    }
+}
+
 void MovingObject_set_position(int mi, double new_pos)
 {
     assert(new_pos >= 0 && new_pos < game_source.basic_source.n_leds);
@@ -186,6 +196,36 @@ static void render_with_z_test(ws2811_led_t color, double alpha, ws2811_led_t* l
     leds[led] = alpha_blend_rgb(color, otherColor, alpha);
 }
 
+/*!
+ * @brief Render opaque span of LEDs `first` to `last` (inclusive) with depth test, this is the same as
+ *        `render_with_z_test` with alpha 1 for every LED. The loop has no branches so that the compiler turns it
+ *        into vector compares and stores
+ * \param colors   colour of every LED of the span from `first` on, or NULL to fill it with `color`
+ */
+static void render_span(ws2811_led_t color, const ws2811_led_t* colors, ws2811_led_t* leds, int first, int last, enum ZdepthIndex zdepth)
+{
+    assert(first >= 0 && last < game_source.basic_source.n_leds);
+    int z = (int)zdepth;
+    color &= 0xFFFFFF;
+    if (colors == NULL)
+    {
+        for (int led = first; led <= last; ++led)
+        {
+            ws2811_led_t keep = (ws2811_led_t)0 - (ws2811_led_t)(canvas[led].zbuffer < z); //all ones when a closer object is there
+            leds[led] = (leds[led] & keep) | (color & ~keep);
+            canvas[led].zbuffer = (canvas[led].zbuffer < z) ? canvas[led].zbuffer : z;
+        }
+        return;
+    }
+    colors -= first;
+    for (int led = first; led <= last; ++led)
+    {
+        ws2811_led_t keep = (ws2811_led_t)0 - (ws2811_led_t)(canvas[led].zbuffer < z);
+        leds[led] = (leds[led] & keep) | (colors[led] & 0xFFFFFF & ~keep);
+        canvas[led].zbuffer = (canvas[led].zbuffer < z) ? canvas[led].zbuffer : z;
+    }
+}
+
 /*!
  * @brief Fill the MoveResults structure
  * 
@@ -316,17 +356,16 @@ int MovingObject_render(int mi, ws2811_led_t* leds)
         return 0;
     assert(mr->updated == 1);
     //printf("Rendering object at positions from %i to %i with color in led 0 %x\n", mr->body_start, mr->body_end, object->color[0]);
-    //render trail
+    //render trail, the edges are antialiased, everything between them is an opaque span
     ws2811_led_t trailing_color = object->color[mr->df_not_aligned * (object->length - 1)];
     if (render_trail == 1)
     {
-        int trailing_led = mr->trail_start;
-        render_with_z_test(trailing_color, 1. - mr->trail_offset, leds, trailing_led, object->zdepth);
-        trailing_led += mr->dir;
-        while (mr->dir * (mr->body_start - trailing_led) >= 0)
+        render_with_z_test(trailing_color, 1. - mr->trail_offset, leds, mr->trail_start, object->zdepth);
+        if (mr->dir * (mr->body_start - mr->trail_start) > 0)
         {
-            render_with_z_test(trailing_color, 1., leds, trailing_led, object->zdepth);
-            trailing_led += mr->dir;
+            int first = (mr->dir > 0) ? mr->trail_start + 1 : mr->body_start;
+            int last = (mr->dir > 0) ? mr->body_start : mr->trail_start - 1;
+            render_span(trailing_color, NULL, leds, first, last, object->zdepth);
         }
     }
     else if (render_trail == 0)
@@ -337,31 +376,35 @@ int MovingObject_render(int mi, ws2811_led_t* leds)
     {
         if (mr->body_offset < 0.5)
         {
-            render_with_z_test(trailing_color, 1, leds, mr->body_start, object->zdepth);
+            render_span(trailing_color, NULL, leds, mr->body_start, mr->body_start, object->zdepth);
         }
     }
 
     // Now render the body, from trailing led to leading led
     // If facing and direction are aligned, we are rendering color from 1 to length-1, if they are opposite, we must render from length - 2 to 0
-    // First and last led are rendered with alpha, the rest with color mixing
-    int body_led = mr->body_start + mr->dir;
-    int color_index = mr->df_not_aligned * (object->length - 3) + 1;
-    while (mr->dir * (mr->body_end - body_led) > 0)
-    //for (uint32_t i = 1, color_index = mr->df_not_aligned * (object->length - 3) + 1; i < object->length; i++, color_index += object->facing * mr->dir)
+    // First and last led are rendered with alpha, the rest is one span, its colours are stored from the lowest LED
+    int n_body = mr->dir * (mr->body_end - mr->body_start) - 1;
+    if (n_body > 0)
     {
-        ws2811_led_t color;
-        if (render_trail < 2)
-        {
-            color = mix_rgb_color(trailing_color, object->color[color_index], (float)mr->body_offset);
-        }
-        else
+        ws2811_led_t body[MAX_OBJECT_LENGTH];
+        int color_index = mr->df_not_aligned * (object->length - 3) + 1;
+        int step = object->facing * mr->dir;
+        int k = (mr->dir > 0) ? 0 : n_body - 1;
+        for (int i = 0; i < n_body; ++i, k += mr->dir)
         {
-            color = (mr->body_offset > 0.5) ? trailing_color : object->color[color_index];
+            if (render_trail < 2)
+            {
+                body[k] = mix_rgb_color(trailing_color, object->color[color_index], (float)mr->body_offset);
+            }
+            else
+            {
+                body[k] = (mr->body_offset > 0.5) ? trailing_color : object->color[color_index];
+            }
+            trailing_color = object->color[color_index];
+            color_index += step;
         }
-        render_with_z_test(color, 1.0, leds, body_led, object->zdepth);
-        trailing_color = object->color[color_index];
-        color_index += object->facing * mr->dir;
-        body_led += mr->dir;
+        int first = (mr->dir > 0) ? mr->body_start + 1 : mr->body_end + 1;
+        render_span(0, body, leds, first, first + n_body - 1, object->zdepth);
     }
     int leading_led = mr->body_end;
     if (render_trail < 2)
@@ -372,7 +415,7 @@ int MovingObject_render(int mi, ws2811_led_t* leds)
     {
         if (mr->body_offset > 0.5)
         {
-            render_with_z_test(trailing_color, 1, leds, leading_led, object->zdepth);
+            render_span(trailing_color, NULL, leds, leading_led, leading_led, object->zdepth);
         }
     }
     return 1;
@@ -35,8 +35,8 @@ static struct
 {
     int level; //0: normal, 1: above, -1: below
     uint64_t level_change_time;
-    int bullets[MAX_PLAYER_BULLETS];
-    int shields[2];
+    object_handle_t bullets[MAX_PLAYER_BULLETS];
+    object_handle_t shields[2];
 } player_object;
 
 
@@ -89,8 +89,11 @@ void PlayerObject_update()
         {
             player_object.level = 0;
             PulseObject_set_color(C_PLAYER_OBJ_INDEX, config.color_index_player, config.color_index_player, config.color_index_player, config.player_ship_size - 1);
-            GameObject_delete_object(player_object.shields[0]);
-            GameObject_delete_object(player_object.shields[1]);
+            for (int s = 0; s < 2; ++s)
+            {
+                int shield = GameObject_resolve(player_object.shields[s]);
+                if (shield != -1) GameObject_delete_object(shield);
+            }
             //printf("Deleting shields\n");
         }
         break;
@@ -140,27 +143,21 @@ void PlayerObject_face_forward()
 
 static int is_player_bullet(int pb_index)
 {
+    int bullet = GameObject_resolve(player_object.bullets[pb_index]);
 #ifdef  GAME_DEBUG
-    if (player_object.bullets[pb_index] == 0)
+    if (bullet == -1)
     {
-        printf("Unused bullet slot\n");
+        printf("Unused bullet slot or the bullet was deleted\n");
         return 0;
     }
-    if (GameObject_is_deleted(player_object.bullets[pb_index]))
+    if (GameObject_get_stencil_flag(bullet) == SF_EnemyProjectile)
     {
-        printf("Bullet was deleted\n");
-        return 0;
-    }
-    if (GameObject_get_stencil_flag(player_object.bullets[pb_index]) == SF_EnemyProjectile)
-    {
-        printf("Bullet was reused as enemy projectile\n");
+        printf("Bullet was turned into enemy projectile\n");
         return 0;
     }
     return 1;
 #else
-    return !(player_object.bullets[pb_index] == 0 ||
-        GameObject_is_deleted(player_object.bullets[pb_index]) ||
-        GameObject_get_stencil_flag(player_object.bullets[pb_index]) == SF_EnemyProjectile);
+    return bullet != -1 && GameObject_get_stencil_flag(bullet) != SF_EnemyProjectile;
 #endif //  GAME_DEBUG
 
 }
@@ -173,8 +170,8 @@ void PlayerObject_cloak()
     {
         if (is_player_bullet(pb_index))
         {
-            GameObject_delete_object(pb_index);
-            player_object.bullets[pb_index] = 0;
+            GameObject_delete_object(GameObject_resolve(player_object.bullets[pb_index]));
+            player_object.bullets[pb_index] = NO_OBJECT_HANDLE;
         }
     }
     player_object.level = 99;
@@ -185,17 +182,19 @@ void PlayerObject_cloak()
     int len = MovingObject_get_length(C_PLAYER_OBJ_INDEX);
     int shield_len = 3;
 
-    player_object.shields[0] = GameObject_new_background_index();
-    if (player_object.shields[0] == -1) return;
-    GameObject_init(player_object.shields[0], 1, SF_Background);
-    MovingObject_init_stopped(player_object.shields[0], pos - shield_len - 1, MO_BACKWARD, shield_len, ZI_Player);
-    PulseObject_init_steady(player_object.shields[0], config.color_index_W, shield_len);
-
-    player_object.shields[1] = GameObject_new_background_index();
-    if (player_object.shields[1] == -1) return;
-    GameObject_init(player_object.shields[1], 1, SF_Background);
-    MovingObject_init_stopped(player_object.shields[1], pos + len + 1, MO_FORWARD, shield_len, ZI_Player);
-    PulseObject_init_steady(player_object.shields[1], config.color_index_W, shield_len);
+    int shield = GameObject_new_background_index();
+    if (shield == -1) return;
+    GameObject_init(shield, 1, SF_Background);
+    player_object.shields[0] = GameObject_handle(shield);
+    MovingObject_init_stopped(shield, pos - shield_len - 1, MO_BACKWARD, shield_len, ZI_Player);
+    PulseObject_init_steady(shield, config.color_index_W, shield_len);
+
+    shield = GameObject_new_background_index();
+    if (shield == -1) return;
+    GameObject_init(shield, 1, SF_Background);
+    player_object.shields[1] = GameObject_handle(shield);
+    MovingObject_init_stopped(shield, pos + len + 1, MO_FORWARD, shield_len, ZI_Player);
+    PulseObject_init_steady(shield, config.color_index_W, shield_len);
 }
 
 static void set_level(int level)
@@ -245,7 +244,7 @@ static void PlayerObject_fire_bullet(int color)
     {
         if (!is_player_bullet(pb_index)) //we found an empty slot
             break;
-        uint64_t pb_time = GameObject_get_time(player_object.bullets[pb_index]);
+        uint64_t pb_time = GameObject_get_time(GameObject_resolve(player_object.bullets[pb_index]));
         if (pb_time < pb_min_time)
         {
             pb_min_time = pb_time;
@@ -259,29 +258,26 @@ static void PlayerObject_fire_bullet(int color)
 #ifdef GAME_DEBUG
         printf("all slots are occupied:\n");
         for (int bi = 0; bi < MAX_PLAYER_BULLETS; ++bi) {
-            double bp = MovingObject_get_position(player_object.bullets[bi]);
-            double bt = (game_source.basic_source.current_time - GameObject_get_time(player_object.bullets[bi])) / (double)1e9;
-            printf("%i: id %i, pos: %f, age: %f s, replace=%i\n", bi, player_object.bullets[bi], bp, bt, bi==pb_min_index);
+            int bullet = GameObject_resolve(player_object.bullets[bi]);
+            double bp = MovingObject_get_position(bullet);
+            double bt = (game_source.basic_source.current_time - GameObject_get_time(bullet)) / (double)1e9;
+            printf("%i: id %i, pos: %f, age: %f s, replace=%i\n", bi, bullet, bp, bt, bi==pb_min_index);
         }
 #endif // GAME_DEBUG
 
         pb_index = pb_min_index;
-        GameObject_delete_object(player_object.bullets[pb_index]);
+        GameObject_delete_object(GameObject_resolve(player_object.bullets[pb_index]));
     }
 
     int i = GameObject_new_projectile_index();
     if (i == -1) return;
-    for (int bi = 0; bi < MAX_PLAYER_BULLETS; ++bi) {
-        if(player_object.bullets[bi] == i) player_object.bullets[bi] = 0;
-    }
-
-    player_object.bullets[pb_index] = i;
+    GameObject_init(i, 1, SF_PlayerProjectile);
+    player_object.bullets[pb_index] = GameObject_handle(i); //handles of earlier bullets in the same slot went stale
 #ifdef GAME_DEBUG
     for (int bi = 0; bi < MAX_PLAYER_BULLETS; ++bi) {
-        printf("%i: %i\n", bi, player_object.bullets[bi]);
+        printf("%i: %i\n", bi, GameObject_resolve(player_object.bullets[bi]));
     }
 #endif
-    GameObject_init(i, 1, SF_PlayerProjectile);
     GameObject_mark(i, 2 << color);
     MovingObject_init_stopped(i, pos, f, 1, ZI_Projectile);
     int color_index = (int[]){ config.color_index_R, config.color_index_G, config.color_index_B } [color];
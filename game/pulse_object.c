@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <assert.h>
 #ifdef __linux__
 #include "ws2811.h"
@@ -21,10 +22,17 @@
 #include "pulse_object.h"
 
 
+#define C_RAMP_STEPS        256     //!< colours of a ramp from colour 0 to colour 1
+#define C_MAX_RAMPS         64
+#define C_WAVE_STEPS        1024    //!< samples of a waveform over one period
+#define C_MAX_WAVES         16
+
 /*!
  * @brief Generate blinking, pulsing and so on
  * Use equation: t =  A * ((1. + cos(f * (t - t0) + phi + led * phi_led)) / 2.) ^ k;
- * Then use t to lerp between colors0 to colors1
+ * Then use t to lerp between colors0 to colors1. Both the curve ((1 - cos) / 2) ^ k and the lerp are
+ * precomputed and shared by all objects: the waveform by the exponent and the colour ramp by the pair of
+ * gradient colours, so an object keeps only a ramp number and the steady colour of every LED
  */
 typedef struct PulseObject
 {
@@ -39,15 +47,92 @@ typedef struct PulseObject
     double frequency;       //!< f = 2*pi/t_period
     double phase;           //!< phi
     double led_phase;		//!< phi_led
-    double spec_exponent;   //!< k
-    hsl_t colors_0[MAX_OBJECT_LENGTH];
-    hsl_t colors_1[MAX_OBJECT_LENGTH];
-    ws2811_led_t next_color[MAX_OBJECT_LENGTH];
+    int wave;               //!< waveform of the exponent k in `waves`
+    uint8_t* ramp;          //!< ramp of every LED in `ramps`, the LEDs grow with the longest object that used the slot
+    ws2811_led_t* next_color;
+    int capacity_ramp;
+    int capacity_next;
     void (*on_end)(int);
 } pulse_object_t;
 
 static pulse_object_t pulse_objects[MAX_N_OBJECTS];
 
+/*! Colour ramps of the pairs of gradient colours in use, ramp 0 is black for LEDs that were not set */
+static struct
+{
+    int n;
+    int color_0[C_MAX_RAMPS];
+    int color_1[C_MAX_RAMPS];
+    ws2811_led_t colors[C_MAX_RAMPS][C_RAMP_STEPS];
+} ramps;
+
+/*! ((1 - cos(x)) / 2) ^ k over x from 0 to 2 pi for the exponents in use */
+static struct
+{
+    int n;
+    double exponent[C_MAX_WAVES];
+    float samples[C_MAX_WAVES][C_WAVE_STEPS];
+} waves;
+
+void PulseObject_clear_ramps()
+{
+    ramps.n = 1;
+    ramps.color_0[0] = ramps.color_1[0] = -1;
+    memset(ramps.colors[0], 0, sizeof(ramps.colors[0]));
+}
+
+/*! @returns ramp from gradient colour `color0` to `color1`, it is computed when the pair is used for the first time */
+static int get_ramp(int color0, int color1)
+{
+    if (ramps.n == 0)
+        PulseObject_clear_ramps();
+    for (int r = 1; r < ramps.n; ++r)
+    {
+        if (ramps.color_0[r] == color0 && ramps.color_1[r] == color1)
+            return r;
+    }
+    if (ramps.n == C_MAX_RAMPS)
+    {
+        printf("Too many pulse colour ramps\n");
+        return 0;
+    }
+    int r = ramps.n++;
+    ramps.color_0[r] = color0;
+    ramps.color_1[r] = color1;
+    hsl_t hsl0, hsl1;
+    rgb2hsl(game_source.basic_source.gradient.colors[color0], &hsl0);
+    rgb2hsl(game_source.basic_source.gradient.colors[color1], &hsl1);
+    fill_hsl_ramp(ramps.colors[r], C_RAMP_STEPS, &hsl0, &hsl1);
+    return r;
+}
+
+static int get_wave(double exponent)
+{
+    for (int w = 0; w < waves.n; ++w)
+    {
+        if (waves.exponent[w] == exponent)
+            return w;
+    }
+    if (waves.n == C_MAX_WAVES)
+    {
+        printf("Too many pulse waveforms\n");
+        return 0;
+    }
+    int w = waves.n++;
+    waves.exponent[w] = exponent;
+    for (int i = 0; i < C_WAVE_STEPS; ++i)
+    {
+        waves.samples[w][i] = (float)pow((1. - cos(2 * M_PI * i / C_WAVE_STEPS)) / 2., exponent);
+    }
+    return w;
+}
+
+/*! Make room for `length` LEDs, the new ones are black */
+static void reserve_colors(pulse_object_t* po, int length)
+{
+    po->ramp = GameObject_reserve_column(po->ramp, &po->capacity_ramp, length, sizeof(uint8_t));
+    po->next_color = GameObject_reserve_column(po->next_color, &po->capacity_next, length, sizeof(ws2811_led_t));
+}
 
 static uint64_t get_time_ms()
 {
@@ -56,6 +141,7 @@ static uint64_t get_time_ms()
 
 static void PulseObject_update_steady(pulse_object_t* po)
 {
+    reserve_colors(po, MovingObject_get_length(po->index));
     MovingObject_apply_colour(po->index, po->next_color);
     po->repetitions = -1;
 }
@@ -87,40 +173,27 @@ static void PulseObject_check_pulse_end(pulse_object_t* po)
     po->end_time = cur_time + (uint64_t)(M_PI / po->frequency);
 }
 
-static double PulseObject_get_t(pulse_object_t* po, uint64_t time_ms, int led)
-{
-    int odd = po->cur_cycle % 2;
-    return po->amplitude * pow((1. - cos(M_PI * (odd - 1) + po->frequency * (time_ms - po->start_time) + po->phase + po->led_phase * led)) / 2., po->spec_exponent);
-}
-
+/*!
+ * @brief Colours of all LEDs at the current time. The angle of the first LED and the step between LEDs are
+ *        turned into waveform samples once, every LED is then two table lookups
+ */
 static void PulseObject_update_pulse(pulse_object_t* po)
 {
     uint64_t time_ms = get_time_ms();
-    double t = PulseObject_get_t(po, time_ms, 0);
-    //printf("t %f, n %lli\n", t, time_ms);
-    int length = MovingObject_get_length(po->index);
-    ws2811_led_t result[MAX_OBJECT_LENGTH];
-    for (int i = 0; i < length; ++i)
-    {
-        hsl_t res;
-        lerp_hsl(&po->colors_0[i], &po->colors_1[i], t, &res);
-        result[i] = hsl2rgb(&res);
-    }
-    MovingObject_apply_colour(po->index, result);
-}
-
-static void PulseObject_update_pulse_per_led(pulse_object_t* po)
-{
-    uint64_t time_ms = get_time_ms();
+    int odd = po->cur_cycle % 2;
+    double angle = M_PI * (odd - 1) + po->frequency * (time_ms - po->start_time) + po->phase;
+    double samples_per_radian = C_WAVE_STEPS / (2 * M_PI);
+    const float* wave = waves.samples[po->wave];
+    float scale = (float)po->amplitude * (C_RAMP_STEPS - 1);
     int length = MovingObject_get_length(po->index);
+    reserve_colors(po, length);
     ws2811_led_t result[MAX_OBJECT_LENGTH];
     for (int i = 0; i < length; ++i)
     {
-        double t = PulseObject_get_t(po, time_ms, i);
-        //printf("t: %f, time: %lli\n", t, time_ms);
-        hsl_t res;
-        lerp_hsl(&po->colors_0[i], &po->colors_1[i], t, &res);
-        result[i] = hsl2rgb(&res);
+        int sample = (int)floor((angle + po->led_phase * i) * samples_per_radian + 0.5) & (C_WAVE_STEPS - 1);
+        int step = (int)(wave[sample] * scale + 0.5f);
+        step = (step < 0) ? 0 : ((step >= C_RAMP_STEPS) ? C_RAMP_STEPS - 1 : step);
+        result[i] = ramps.colors[po->ramp[i]][step];
     }
     MovingObject_apply_colour(po->index, result);
 }
@@ -139,19 +212,20 @@ void PulseObject_update(int pi)
     case PM_REPEAT:
     case PM_ONCE:
     case PM_FADE:
-        if (po->led_phase != 0)
-        {
-            PulseObject_update_pulse_per_led(po);
-        }
-        else
-        {
-            PulseObject_update_pulse(po);
-        }
+        PulseObject_update_pulse(po);
         PulseObject_check_pulse_end(po);
         break;
     }
 }
 
+void PulseObject_update_all(const int16_t* objects, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        PulseObject_update(objects[i]);
+    }
+}
+
 void PulseObject_init(int pi, double amp, enum PulseModes pm, int repetitions, int period, double phase, double led_phase, double spec, void(*on_end)(int))
 {
     pulse_object_t* po = &pulse_objects[pi];
@@ -163,7 +237,7 @@ void PulseObject_init(int pi, double amp, enum PulseModes pm, int repetitions, i
     po->frequency =  M_PI / (double)period;
     po->phase = phase;
     po->led_phase = led_phase;
-    po->spec_exponent = spec;
+    po->wave = get_wave(spec);
 
     po->start_time = get_time_ms();
     po->end_time = po->start_time + period;
@@ -174,13 +248,11 @@ void PulseObject_set_color_all(int pi, int color_index_0, int color_index_1, int
 {
     assert(length <= MAX_OBJECT_LENGTH);
     pulse_object_t* po = &pulse_objects[pi];
-    hsl_t res0, res1;
-    rgb2hsl(game_source.basic_source.gradient.colors[color_index_0], &res0);
-    rgb2hsl(game_source.basic_source.gradient.colors[color_index_1], &res1);
+    reserve_colors(po, length);
+    uint8_t ramp = (uint8_t)get_ramp(color_index_0, color_index_1);
+    memset(po->ramp, ramp, length);
     for (int i = 0; i < length; ++i)
     {
-        po->colors_0[i] = res0;
-        po->colors_1[i] = res1;
         po->next_color[i] = game_source.basic_source.gradient.colors[next_color];
     }
     if (po->repetitions == -1) po->repetitions = 0;
@@ -189,8 +261,8 @@ void PulseObject_set_color_all(int pi, int color_index_0, int color_index_1, int
 void PulseObject_set_color(int pi, int color0, int color1, int color_next, int led)
 {
     pulse_object_t* po = &pulse_objects[pi];
-    rgb2hsl(game_source.basic_source.gradient.colors[color0], po->colors_0 + led);
-    rgb2hsl(game_source.basic_source.gradient.colors[color1], po->colors_1 + led);
+    reserve_colors(po, led + 1);
+    po->ramp[led] = (uint8_t)get_ramp(color0, color1);
     po->next_color[led] = game_source.basic_source.gradient.colors[color_next];
     if (po->repetitions == -1) po->repetitions = 0;
 }
@@ -201,9 +273,23 @@ void PulseObject_init_steady(int pi, int color_index, int length)
     po->index = pi;
     po->pulse_mode = PM_STEADY;
     po->repetitions = 0;
+    reserve_colors(po, length);
     for (int i = 0; i < length; ++i)
     {
         po->next_color[i] = game_source.basic_source.gradient.colors[color_index];
     }
     po->on_end = NULL;
 }
+
+void PulseObject_free_all()
+{
+    for (int pi = 0; pi < MAX_N_OBJECTS; ++pi)
+    {
+        pulse_object_t* po = &pulse_objects[pi];
+        free(po->ramp);
+        free(po->next_color);
+        po->ramp = NULL;
+        po->next_color = NULL;
+        po->capacity_ramp = po->capacity_next = 0;
+    }
+}
@@ -29,11 +29,27 @@
  * @brief Handlers are indexed in_stencil_object_index * SF_N_FLAGS + object_being_checked_index
  * All handlers take pointers in this order and
  * @return  1 - use the new index
- *          2 - use the new index and erase the old index from here to end
+ *          2 - use the new index and erase the old object from the stencil
  *          0 - keep the use already written index
  */
 static int (*stencil_handlers[SF_N_FLAGS * SF_N_FLAGS])(int, int);
 
+#define C_MAX_SPANS (2 * MAX_N_OBJECTS + 1) //!< every object adds at most two span boundaries
+
+/*!
+ * Stencil of the frame as disjoint spans of LEDs [start, end) sorted by start, each of them owned by one object.
+ * An object is tested against the spans it overlaps, so a handler runs once per pair of objects that meet,
+ * and the cost does not depend on how many LEDs they cover
+ */
+static struct
+{
+    int n;
+    int start[C_MAX_SPANS];
+    int end[C_MAX_SPANS];
+    int16_t object_index[C_MAX_SPANS];
+    uint8_t stencil[C_MAX_SPANS];
+} spans;
+
 
 static int StencilHandler_impossible(int obj1, int obj2)
 {
@@ -100,16 +116,67 @@ static int StencilHandler_player_reached_stargate(int gate, int player)
     return 1;
 }
 
-static void Stencil_erase_object(int start_led, int dir)
+void Stencil_clear()
+{
+    spans.n = 0;
+}
+
+/*! @returns the first span that ends after `led` */
+static int first_span_after(int led)
+{
+    int lo = 0;
+    int hi = spans.n;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (spans.end[mid] <= led)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int Stencil_get_object(int led, enum StencilFlags* stencil)
+{
+    int i = first_span_after(led);
+    if (i == spans.n || spans.start[i] > led)
+        return -1;
+    if (stencil) *stencil = spans.stencil[i];
+    return spans.object_index[i];
+}
+
+/*! Append span [start, end) to the list, it is merged with the last one if they touch and have the same owner */
+static void add_span(int* n, int* start, int* end, int16_t* object_index, uint8_t* stencil, int s, int e, int oi, int sf)
+{
+    if (s >= e)
+        return;
+    if (*n > 0 && end[*n - 1] == s && object_index[*n - 1] == oi && stencil[*n - 1] == sf)
+    {
+        end[*n - 1] = e;
+        return;
+    }
+    start[*n] = s;
+    end[*n] = e;
+    object_index[*n] = oi;
+    stencil[*n] = sf;
+    (*n)++;
+}
+
+static void erase_object(int object_index)
 {
-    int stencil_index = canvas[start_led].stencil;
-    int led = start_led;
-    while (canvas[led].stencil == stencil_index)
+    int n = 0;
+    for (int i = 0; i < spans.n; ++i)
     {
-        canvas[led].stencil = -1;
-        canvas[led].object_index = -1;
-        led += dir;
+        if (spans.object_index[i] == object_index)
+            continue;
+        spans.start[n] = spans.start[i];
+        spans.end[n] = spans.end[i];
+        spans.object_index[n] = spans.object_index[i];
+        spans.stencil[n] = spans.stencil[i];
+        n++;
     }
+    spans.n = n;
 }
 
 void Stencil_stencil_test(int object_index, int stencil_flag)
@@ -123,56 +190,92 @@ void Stencil_stencil_test(int object_index, int stencil_flag)
     
     int led_start, led_end, dir;
     MovingObject_get_move_results(object_index, &led_start, &led_end, &dir);
+    (void)dir;
     assert(led_start >= 0 && led_start < game_source.basic_source.n_leds);
     assert(led_end >= 0 && led_end < game_source.basic_source.n_leds);
+    int span_start = led_start;
+    int span_end = led_end + 1;
+
+    //spans first .. last - 1 overlap the object, they are replaced by the pieces it is cut into
+    int first = first_span_after(span_start);
+    int last = first;
+    while (last < spans.n && spans.start[last] < span_end)
+        last++;
+
+    int n = 0;
+    int start[C_MAX_SPANS];
+    int end[C_MAX_SPANS];
+    int16_t owner[C_MAX_SPANS];
+    uint8_t stencil[C_MAX_SPANS];
     int other_index = -1;
     int result_stencil = -1;
     int result_index = -1;
-    for (int led = led_start; led <= led_end; ++led)
+    int erased = -1;
+    if (first < last && spans.start[first] < span_start) //the part of the first span in front of the object stays
+        add_span(&n, start, end, owner, stencil, spans.start[first], span_start, spans.object_index[first], spans.stencil[first]);
+    int led = span_start;
+    for (int i = first; i < last; ++i)
     {
-        if (canvas[led].object_index == -1)
+        int overlap_start = (spans.start[i] > span_start) ? spans.start[i] : span_start;
+        int overlap_end = (spans.end[i] < span_end) ? spans.end[i] : span_end;
+        add_span(&n, start, end, owner, stencil, led, overlap_start, object_index, stencil_flag);
+        led = overlap_end;
+        if (spans.object_index[i] == erased)
         {
-            canvas[led].stencil = stencil_flag;
-            canvas[led].object_index = object_index;
+            add_span(&n, start, end, owner, stencil, overlap_start, overlap_end, object_index, stencil_flag);
             continue;
         }
-        //we have a collision and we have to handle it
-        if (canvas[led].object_index == other_index) //we've solved this collision here before
+        //we have a collision and we have to handle it, unless we've solved it with this object before
+        if (spans.object_index[i] != other_index)
         {
-            canvas[led].stencil = result_stencil;
-            canvas[led].object_index = result_index;
-            continue;
-        }
-        other_index = canvas[led].object_index;
-        int handler_index = canvas[led].stencil * SF_N_FLAGS + stencil_flag;
-        int res;
-        if (!stencil_handlers[handler_index]) //we don't have a handler, default option is to replace the old stencil
-        {
-            res = 1;
+            other_index = spans.object_index[i];
+            int handler_index = spans.stencil[i] * SF_N_FLAGS + stencil_flag;
+            int res;
+            if (!stencil_handlers[handler_index]) //we don't have a handler, default option is to replace the old stencil
+            {
+                res = 1;
+            }
+            else
+            {
+                res = stencil_handlers[handler_index](other_index, object_index);
+            }
+            switch (res)
+            {
+            case 2:
+                erased = other_index;
+                result_stencil = stencil_flag;
+                result_index = object_index;
+                break;
+            case 1:
+                result_stencil = stencil_flag;
+                result_index = object_index;
+                break;
+            case 0:
+                result_stencil = spans.stencil[i];
+                result_index = other_index;
+                break;
+            }
         }
-        else
-        {
-            res = stencil_handlers[handler_index](other_index, object_index);
-        }
-        switch (res)
-        {
-        case 2:
-            Stencil_erase_object(led, dir);
-            result_stencil = stencil_flag;
-            result_index = object_index;
-            break;
-        case 1:
-            result_stencil = stencil_flag;
-            result_index = object_index;
-            break;
-        case 0:
-            result_stencil = canvas[led].stencil;
-            result_index = other_index;
-            break;
-        }
-        canvas[led].stencil = result_stencil;
-        canvas[led].object_index = result_index;
+        add_span(&n, start, end, owner, stencil, overlap_start, overlap_end, result_index, result_stencil);
     }
+    add_span(&n, start, end, owner, stencil, led, span_end, object_index, stencil_flag);
+    if (first < last && spans.end[last - 1] > span_end) //and so does the part of the last span behind it
+        add_span(&n, start, end, owner, stencil, span_end, spans.end[last - 1], spans.object_index[last - 1], spans.stencil[last - 1]);
+
+    //splice the pieces in place of the overlapped spans
+    int tail = spans.n - last;
+    assert(first + n + tail <= C_MAX_SPANS);
+    memmove(spans.start + first + n, spans.start + last, sizeof(int) * tail);
+    memmove(spans.end + first + n, spans.end + last, sizeof(int) * tail);
+    memmove(spans.object_index + first + n, spans.object_index + last, sizeof(int16_t) * tail);
+    memmove(spans.stencil + first + n, spans.stencil + last, sizeof(uint8_t) * tail);
+    memcpy(spans.start + first, start, sizeof(int) * n);
+    memcpy(spans.end + first, end, sizeof(int) * n);
+    memcpy(spans.object_index + first, owner, sizeof(int16_t) * n);
+    memcpy(spans.stencil + first, stencil, sizeof(uint8_t) * n);
+    spans.n = first + n + tail;
+    if (erased != -1)
+        erase_object(erased);
 }
 
 void Stencil_init(enum GameModes current_mode)
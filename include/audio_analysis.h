@@ -0,0 +1,48 @@
+#ifndef __AUDIO_ANALYSIS_H__
+#define __AUDIO_ANALYSIS_H__
+
+#define AA_N_BANDS           5
+#define ONSET_THRESHOLD      0.1f     //a value between 0.1 (more detections) and 1 (less); default=0.3
+#define FQ_BASS             250		  //< upper bound for basses
+#define FQ_MID_BASS        1000       //< upper bound for bass to mid
+#define FQ_MID_TREBLE      3000       //< lower boudn for mid to treble
+#define FQ_TREBLE          6000		  //< lower bound for trebles
+#define FFT_WINDOW           4        //< how many times is the whole FFT window wider than one frame
+#define FQ_STAT_LEN        100        //< how many bins we have to gather statistics
+#define FQ_RECALIBRATE   10000        //< how often (in hops) are the band boundaries recalibrated
+
+/*!
+ * Features of one hop (one frame worth of samples) of the captured sound. They are calculated on the
+ * capture thread, sources only get a copy of the latest ones and never touch aubio
+ */
+typedef struct AudioFeatures
+{
+    unsigned int hop;                       //!< sequence number, increases by one with every analysed hop
+    unsigned int total_samples;             //!< position of the end of this hop in the stream
+    int is_silent;                          //!< when 1, only `hop` and `total_samples` are valid
+    int is_onset;                           //!< 1 if beat was detected in this hop
+    float band_energy[AA_N_BANDS];          //!< sum of FFT magnitudes in each band, bands are recalibrated to carry similar energy
+    float bpm;
+    float beat_phase;                       //!< 1 at the start of the beat, 0 at the end of the beat
+    float spectral_centroid;                //!< in Hz
+} audio_features_t;
+
+/*!
+ * @brief Start audio capture and analysis, safe to call from several sources, every start must be paired with stop
+ * @param frame_time    length of one frame in us, the hop is the nearest power of 2 that covers one frame
+ * @param wav_file      if not NULL, analyse this file instead of the sound card
+ */
+void AudioAnalysis_start(uint64_t frame_time, const char* wav_file);
+
+/*!
+ * @brief Get the features of the latest analysed hop, never blocks
+ * @returns 1 if these are new features since the last call, 0 if they are the same as last time
+ */
+int AudioAnalysis_get_features(audio_features_t* features);
+
+/*! @brief Copy of the features the last `AudioAnalysis_get_features` returned, it does not capture or swap anything */
+void AudioAnalysis_peek_features(audio_features_t* features);
+
+void AudioAnalysis_stop();
+
+#endif /* __AUDIO_ANALYSIS_H__ */
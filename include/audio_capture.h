@@ -0,0 +1,67 @@
+#ifndef __AUDIO_CAPTURE_H__
+#define __AUDIO_CAPTURE_H__
+
+#define INT_TO_FLOAT         3.0517578125e-05f // = 1. / 32768.
+#define AUDIO_RING_LENGTH    16384      //< length of the ring buffer in samples, must be power of 2
+#define AUDIO_CHANNELS           2      //< we capture interleaved stereo and downmix it to mono
+#define AUDIO_RT_PRIORITY       50      //< SCHED_FIFO priority of the capture thread
+
+/*!
+ * @brief Open the capture device, or the wav file that stands in for it
+ * @param samplerate        desired samplerate, it will be overwritten with the real samplerate of the device or file
+ * @param samples_per_read  how many samples the thread reads from the device at once
+ * @param wav_file          if not NULL, samples are read from this file (S16 stereo) in real time instead of the sound card
+ */
+void AudioCapture_open(unsigned int* samplerate, unsigned int samples_per_read, const char* wav_file);
+
+/*!
+ * @brief Start the capture thread. The thread reads interleaved S16 stereo, downmixes it to mono floats
+ *        in range <-1; 1> and pushes them to a lock-free ring buffer
+ * @param on_capture        if not NULL, it is called on the capture thread after every block, typically to consume the samples
+ */
+void AudioCapture_start(void (*on_capture)());
+
+/*! Without the capture thread (on Windows) this captures one block synchronously when the ring buffer runs dry, otherwise it does nothing */
+void AudioCapture_poll();
+
+/*!
+ * @brief Read the wav file offline, call before `AudioCapture_open`. There is no thread, no pacing and the
+ *        file is not looped, blocks are captured only by `AudioCapture_step`
+ */
+void AudioCapture_set_offline();
+
+/*! Offline, capture exactly one block and run the capture callback on it */
+void AudioCapture_step();
+
+/*! @returns 1 when the offline wav file has been read to the end */
+int AudioCapture_is_finished();
+
+/*! @returns number of samples that can be read without blocking */
+unsigned int AudioCapture_available();
+
+/*!
+ * @brief Copy samples from the ring buffer, never blocks
+ * @param out           buffer for at least `n_samples` floats
+ * @param n_samples     how many samples to copy
+ * @returns             1 if `n_samples` were copied, 0 if there was not enough data (and nothing was copied)
+ */
+int AudioCapture_read(float* out, unsigned int n_samples);
+
+/*! @returns number of reads that failed (xruns) or were dropped because the ring buffer was full */
+unsigned int AudioCapture_get_xruns();
+
+/*!
+ * @brief Deinterleave, downmix and scale S16 stereo to mono floats in range <-1; 1>. Uses NEON or SSE2 when available
+ * @param in            interleaved stereo, 2 * `n_samples` values
+ * @param out           buffer for `n_samples` floats
+ * @param min, max      running minimum and maximum of the output, they are only updated, not reset
+ */
+void AudioCapture_convert(const int16_t* in, float* out, unsigned int n_samples, float* min, float* max);
+
+/*! Compare the conversion kernel against the old sample by sample loop and print the timings */
+void AudioCapture_benchmark();
+
+/*! Stop the capture thread and close the device */
+void AudioCapture_stop();
+
+#endif /* __AUDIO_CAPTURE_H__ */
@@ -0,0 +1,25 @@
+#ifndef __AUDIO_REGRESSION_H__
+#define __AUDIO_REGRESSION_H__
+
+#define AR_BPM_TOLERANCE     0.5f     //< bpm in the trace may differ this much from the golden one
+#define AR_MAX_REPORTED        10     //< only this many mismatches are printed, all of them are counted
+
+/*!
+ * @brief Start the offline regression run. The wav given by --audio_file is read without the capture thread
+ *        and the frames run on a virtual clock, one hop of audio per frame, so the run is repeatable and fast.
+ *        A replay of a recorded session (--replay) is traced the same way, with the audio columns left at 0
+ * @param trace_file    every frame writes one line here: frame, total_samples, bpm, onset, hash of all LEDs, first LED
+ * @param golden_file   if not NULL, trace recorded earlier, every frame is compared against it
+ */
+void AudioRegression_init(const char* trace_file, const char* golden_file);
+
+/*! @brief Write the trace of one frame and compare it against the golden trace, call after the LEDs were updated */
+void AudioRegression_record(long frame, ws2811_t* ledstrip);
+
+/*!
+ * @brief Print the summary (frames, mismatches, CPU time per frame) and close the files
+ * @returns number of mismatches, 0 if the run matches the golden trace or there was none
+ */
+int AudioRegression_finish();
+
+#endif /* __AUDIO_REGRESSION_H__ */
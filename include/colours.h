@@ -59,6 +59,13 @@ void fill_gradient(ws2811_led_t* gradient, int offset, ws2811_led_t from_color,
 void lerp_hsl(const hsl_t* hsl1, const hsl_t* hsl2, const float t, hsl_t* hsl_out);
 /*! \returns  rgb1 for t == 0 and rgb2 for t == 1 */
 ws2811_led_t lerp_rgb(const ws2811_led_t rgb1, const ws2811_led_t rgb2, const float t);
+/*! Precompute `steps` colours of `lerp_hsl` from hsl1 to hsl2 as RGB, so that rendering is a lookup instead of conversion per LED */
+void fill_hsl_ramp(ws2811_led_t* ramp, int steps, const hsl_t* hsl1, const hsl_t* hsl2);
+/*!
+ * @brief out = (from * (256 - weight) + to * weight) / 256 channel by channel, in fixed point for whole buffers.
+ *        Weight 0 or less copies `from`, 256 or more copies `to`. Uses NEON or SSE2 when available
+ */
+void lerp_rgb_buffer(const ws2811_led_t* from, const ws2811_led_t* to, int weight, ws2811_led_t* out, int n_leds);
 void hsl_copy(const hsl_t* hsl_in, hsl_t* hsl_out);
 void test_rgb2hsl();
 
@@ -39,11 +39,18 @@ typedef struct SourceGradient
     int n_colors;
 } SourceGradient;
 
+/*! State of a xoshiro128+ generator. Every source has its own stream, so sources do not shift each other's sequences */
+typedef struct Random
+{
+    uint32_t s[4];
+} random_t;
+
 typedef struct BasicSource
 {
     int n_leds;
     int time_speed;
     SourceGradient gradient;
+    random_t random;       //!< seeded by the source manager whenever the source is set
     uint64_t current_time; //!< in ns
     uint64_t time_delta;   //!< in ns
     void(*construct)();
@@ -63,7 +70,17 @@ extern SourceConfig source_config;
 void BasicSource_construct(BasicSource* basic_source);
 void BasicSource_init(BasicSource* basic_source, int n_leds, int time_speed, SourceColors* source_colors, uint64_t current_time);
 void BasicSource_build_gradient(BasicSource* basic_source, ws2811_led_t* colors, int* steps, int n_steps);
+/*! @brief Seed the stream, the same seed gives the same sequence on every platform */
+void Random_seed(random_t* random, uint64_t seed);
+/*! @returns uniformly distributed number in <0; 1) */
+float Random_01(random_t* random);
+/*! @brief Fill `out` with `n` numbers in <0; 1), the same ones `n` calls of `Random_01` would return */
+void Random_01_n(random_t* random, float* out, int n);
+/*! @brief Make `random` the stream of `random_01`, the source manager selects the stream of the active source */
+void Random_set_current(random_t* random);
+/*! @returns number in <0; 1) from the stream of the active source */
 float random_01();
+void random_01_n(float* out, int n);
 
 
 #endif /* __COMMON_SOURCE_H__ */
@@ -30,6 +30,10 @@ struct
 
 
 #define MAX_N_OBJECTS     256
+#define NO_OBJECT_HANDLE  0     //!< never refers to an object, zeroed handles are empty
+
+/*! Object index in the low 16 bits and the generation of its slot above, it goes stale when the object is deleted */
+typedef uint32_t object_handle_t;
 
 extern const int C_PLAYER_OBJ_INDEX;
 
@@ -50,6 +54,7 @@ enum GameModes
 extern char win_messages[GM_PLAYER_LOST][16];
 
 void GameObjects_init();
+void GameObjects_destruct();
 int GameObjects_update_leds(int frame, ws2811_t* ledstrip);
 enum GameModes GameObjects_get_current_mode();
 
@@ -71,6 +76,19 @@ enum StencilFlags GameObject_get_stencil_flag(int gi);
 int GameObject_new_projectile_index();
 int GameObject_new_background_index();
 
+/*! @returns handle of the live object `gi`, keep it instead of the index when the object can die meanwhile */
+object_handle_t GameObject_handle(int gi);
+/*! @returns index of the object, -1 when it was deleted or its slot got another object since the handle was taken */
+int GameObject_resolve(object_handle_t handle);
+
+/*!
+ * @brief Grow a column of per-LED data of an object, e.g. its colours, so that it holds `needed` items.
+ *        The column never shrinks, the next object in the slot reuses it. New items are zeroed
+ * @param capacity  number of items in `column`, updated
+ * @returns         the column, possibly moved; the program exits when out of memory
+ */
+void* GameObject_reserve_column(void* column, int* capacity, int needed, size_t item_size);
+
 void GameObject_mark(int gi, int mark);
 void GameObject_clear_mark(int gi, int mark);
 int GameObject_get_mark(int gi);
@@ -0,0 +1,117 @@
+#ifndef __GEOMETRY_H__
+#define __GEOMETRY_H__
+
+#include <stdint.h>
+
+#define GEOMETRY_TEXT_FILE      "geometry"
+#define GEOMETRY_BINARY_FILE    "geometry.bin"
+#define GEOMETRY_MAGIC          0x4D4F4547      //< "GEOM" in little endian
+#define GEOMETRY_VERSION        1
+#define GEOMETRY_INDEX_RADIUS   12              //< spatial index knows neighbourhoods up to this distance
+#define GEOMETRY_UNREACHABLE    0xFFFF          //< hops and distance of LEDs that cannot be reached from the seed
+
+typedef enum dir {
+    UP,
+    RIGHT,
+    DOWN,
+    LEFT,
+    FORWARD,
+    BACKWARD,
+    N_DIRS,
+    N_COMPASS_DIRS = 4      //!< up, right, down and left, the rest are neighbours on the strip
+} dir_t;
+
+/*!
+ * Geometry of the LEDs in space, compiled for fast lookups during rendering. Each array is separate
+ * and tightly packed, LED indices are 16 bit, -1 means there is no neighbour.
+ *
+ * Heads are LEDs such that there is something below me, the LED below me points back to me,
+ * and I am either top, or the LED above does not point back to me. Springs are the same at the bottom:
+ *           1               neighbor[1][UP] = -1; neighbor[1][DOWN] = 2
+ *           |\              neighbor[2][UP] =  1; neighbor[2][DOWN] = 4
+ *           2-3             neighbor[3][UP] =  1; neighbor[3][DOWN] = 5
+ *           | |\            neighbor[4][UP] =  2; neighbor[4][DOWN] = 7
+ *           4-5-6           neighbor[5][UP] =  3; neighbor[5][DOWN] = 7
+ *            \|\|           neighbor[6][UP] =  3; neighbor[6][DOWN] = 8
+ *             7 8           neighbor[7][UP] =  5; neighbor[8][UP] = 6
+ * Heads are 1, 3, 6
+ */
+typedef struct Geometry
+{
+    int n_leds;
+    int16_t (*neighbor)[N_DIRS];    //!< index of the neighbour in every direction
+    uint8_t (*distance)[N_DIRS];    //!< distance to the neighbour in every direction
+    int16_t* height;                //!< how many LEDs there are below me
+    int16_t* ring;                  //!< 1 for springs, +1 for every step up, 0 if the LED cannot be reached from a spring
+    //compass neighbours in compressed sparse rows: neighbours of `led` are adjacent[adjacent_start[led]] .. adjacent[adjacent_start[led + 1] - 1]
+    uint16_t* adjacent_start;       //!< n_leds + 1 items
+    uint16_t* adjacent;
+    uint8_t* adjacent_distance;
+    int n_adjacent;
+    int16_t* heads;
+    int16_t* springs;
+    int n_heads;
+    int n_springs;
+    //spatial index, NULL until the first query
+    uint32_t (*near_start)[GEOMETRY_INDEX_RADIUS + 2]; //!< LEDs at distance d from `led` are near[near_start[led][d]] .. near[near_start[led][d + 1] - 1]
+    uint16_t* near;                 //!< for every LED all LEDs up to GEOMETRY_INDEX_RADIUS, sorted by distance
+    uint8_t* near_distance;
+    uint16_t* by_height;            //!< all LEDs sorted by height
+    uint16_t* height_start;         //!< LEDs of height h are by_height[height_start[h]] .. by_height[height_start[h + 1] - 1]
+    int max_height;
+    struct GeometryField** fields;  //!< distance field of every seed LED, NULL until it is first asked for
+} geometry_t;
+
+/*! Result of a spatial query, LEDs are sorted by distance (or height), `distance` is NULL for height queries */
+typedef struct GeometrySpan
+{
+    const uint16_t* leds;
+    const uint8_t* distance;
+    int count;
+} geometry_span_t;
+
+/*! Distances from one seed LED to every LED of the tree, along the compass neighbours */
+typedef struct GeometryField
+{
+    int seed;
+    uint16_t* hops;                 //!< number of steps from the seed
+    uint16_t* distance;             //!< distance from the seed, as in the geometry file
+    int max_hops;                   //!< of the reachable LEDs
+    int max_distance;
+} geometry_field_t;
+
+/*!
+ * @brief Load the geometry, the binary file is used when it is present and was compiled for the same
+ *        number of LEDs, otherwise the text file is parsed and compiled
+ * @returns 1 on success, 0 on failure
+ */
+int Geometry_load(geometry_t* geometry, int n_leds);
+
+/*!
+ * @brief Compile the text geometry (one row per LED: up, right, down and left neighbour, each followed by distance)
+ *        into the binary one, so that it does not have to be parsed and compiled on every start
+ * @returns 1 on success, 0 on failure
+ */
+int Geometry_compile(const char* text_file, const char* binary_file, int n_leds);
+
+void Geometry_free(geometry_t* geometry);
+
+// The spatial index behind the following queries is built on the first of them and kept until `Geometry_free`,
+// if there is not enough memory for it they return no LEDs
+
+/*! @brief All LEDs within `radius` (distance along the wires, as in the geometry file) of `led`, including `led` itself, in O(1) */
+geometry_span_t Geometry_within(geometry_t* geometry, int led, int radius);
+
+/*! @brief All LEDs exactly `radius` from `led`, in O(1) */
+geometry_span_t Geometry_ring(geometry_t* geometry, int led, int radius);
+
+/*! @brief All LEDs with `from` <= height < `to`, in O(1) */
+geometry_span_t Geometry_height_band(geometry_t* geometry, int from, int to);
+
+/*!
+ * @brief Distance field of `seed`, it is built on the first call and kept until `Geometry_free`,
+ *        so that effects can render waves as a lookup per LED without walking the graph
+ */
+const geometry_field_t* Geometry_field(geometry_t* geometry, int seed);
+
+#endif /* __GEOMETRY_H__ */
@@ -0,0 +1,77 @@
+#ifndef __KEYFRAMES_H__
+#define __KEYFRAMES_H__
+
+#define KF_DEFAULT_INTERVAL 100 //!< in ms, interval of a newly added frame
+
+typedef enum KeyframeEasing {
+    KE_LINEAR,
+    KE_SMOOTH,      //!< slow at both frames, smoothstep
+    KE_EASE_IN,     //!< slow at the frame, fast at the next one
+    KE_EASE_OUT,    //!< fast at the frame, slow at the next one
+    KE_HOLD,        //!< no interpolation, the frame is shown until the next one
+    N_KEYFRAME_EASINGS
+} keyframe_easing_t;
+
+/*!
+ * Animation of LED colours, the frames are stored as RGB one after another in the order they are played and
+ * the last one runs into the first one. Interpolation is done per channel in fixed point, so a frame costs
+ * about as much as copying it. The storage grows as needed, there is no limit on the number of frames
+ */
+typedef struct Keyframes
+{
+    int n_leds;
+    int n;                          //!< frames 0 .. n - 1 are in use
+    int capacity;
+    ws2811_led_t* colors;           //!< n_leds colours of every frame
+    int* interval;                  //!< ms from the frame to the next one
+    uint8_t* easing;                //!< keyframe_easing_t from the frame to the next one
+    //playback
+    int current;                    //!< frame being played, -1 when the animation is stopped
+    uint64_t frame_start;           //!< time when the current frame was reached, in ns
+} keyframes_t;
+
+/*! @returns 1 on success, 0 when out of memory */
+int Keyframes_init(keyframes_t* keyframes, int n_leds, int capacity);
+
+void Keyframes_free(keyframes_t* keyframes);
+
+/*!
+ * @brief Make sure that `capacity` frames fit without reallocation, the storage at least doubles when it grows
+ *        so that adding frames one by one is cheap as well
+ * @returns 1 on success, 0 when out of memory
+ */
+int Keyframes_reserve(keyframes_t* keyframes, int capacity);
+
+/*! @brief Remove all frames and stop the animation, nothing is freed */
+void Keyframes_clear(keyframes_t* keyframes);
+
+/*!
+ * @brief Make room for a new frame at `position` (0 to n), the frames behind it move by one
+ * @returns colours of the new frame to be filled in by the caller, NULL for invalid position or when out of memory
+ */
+ws2811_led_t* Keyframes_insert(keyframes_t* keyframes, int position);
+
+/*! @returns 1 if the frame was removed, 0 for invalid position */
+int Keyframes_remove(keyframes_t* keyframes, int position);
+
+/*! @returns 1 if the frames were swapped, 0 for invalid positions */
+int Keyframes_swap(keyframes_t* keyframes, int position1, int position2);
+
+/*! @returns colours of the frame at `position`, NULL for invalid position */
+ws2811_led_t* Keyframes_frame(keyframes_t* keyframes, int position);
+
+/*! @returns 1 on success, 0 for invalid position or easing. Intervals below 1 ms are 1 ms */
+int Keyframes_set_timing(keyframes_t* keyframes, int position, int interval, keyframe_easing_t easing);
+
+/*! @brief Play from the first frame, nothing is played when there are no frames */
+void Keyframes_start(keyframes_t* keyframes, uint64_t current_time);
+
+void Keyframes_stop(keyframes_t* keyframes);
+
+/*!
+ * @brief Interpolate the colours at `current_time` (in ns) to `out`. Uses NEON or SSE2 when available
+ * @returns 1 if the animation is playing, 0 when it is stopped and `out` is untouched
+ */
+int Keyframes_render(keyframes_t* keyframes, uint64_t current_time, ws2811_led_t* out);
+
+#endif /* __KEYFRAMES_H__ */
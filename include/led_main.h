@@ -20,6 +20,14 @@ struct ArgOptions
     int time_speed;
     uint64_t frame_time;
     enum SourceType source_type;
+    char* audio_file;
+    int benchmark;
+    char* trace_file;           //!< offline regression run writes the trace here
+    char* golden_file;          //!< offline regression run compares against this trace
+    char* geometry_file;        //!< compile the text geometry into this binary file and exit
+    char* record_file;          //!< record the session for a replay here
+    char* replay_file;          //!< replay this recorded session headless, as fast as possible
+    uint32_t seed;              //!< of the random streams of the sources, a replay takes it from the recording
 };
 
 #endif /* __LED_MAIN_SOURCE_H__ */
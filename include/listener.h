@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #define LISTENER_ADDRESS "tcp://localhost:5556"
+#define LISTENER_MAX_MESSAGE (1 << 20) //!< bigger messages are dropped by ZeroMQ, e.g. bulk key frame uploads fit
 
 struct Listener {
     void* context;
@@ -62,7 +62,7 @@ typedef struct Match3LevelDefinition
 } match3_LevelDefinition_t;
 
 #define MATCH3_N_LEVELS 4
-#define N_MAX_SEGMENTS 32
+#define N_SEGMENTS_BLOCK 32 //!< segments are allocated in blocks of this size, there is no limit on their number
 #define N_MAX_BULLETS 16
 
 extern const int C_LED_Z;
@@ -27,8 +27,6 @@ enum ZdepthIndex //lower number is closer to camera, i.e. it will be rendered
 typedef struct CanvasPixel
 {
     int zbuffer;
-    int stencil;
-    int object_index;
 } pixel_t;
 
 /*! Canvas for painting helper information (not actual colours), like z-buffer */
@@ -40,6 +38,9 @@ void Canvas_clear(ws2811_led_t* leds);
 /*! Init MovingObject with basic values and single colour */
 void MovingObject_init_stopped(int mi, double position, enum MovingObjectFacing facing, uint32_t length, enum ZdepthIndex zdepth);
 
+/*! Free the colours of all objects */
+void MovingObject_free_all();
+
 /*! Init MovingObject with movement data */
 void MovingObject_init_movement(int mi, double speed, int target, void(*on_arrival)(int));
 
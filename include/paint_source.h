@@ -16,7 +16,7 @@ Originally, I intended this to be really just a painting application, no games,
 always does.
  */
 
-#define C_N_KEY_FRAMES 255
+#define C_N_KEY_FRAMES 16 //!< key frames allocated up front, the storage grows when more arrive
 
 typedef struct paint_SPaintSource
 {
@@ -0,0 +1,73 @@
+#ifndef __PARTICLES_H__
+#define __PARTICLES_H__
+
+typedef enum ParticleBlend {
+    PB_REPLACE,     //!< the particle overwrites the LED
+    PB_MAX,         //!< brighter of the particle and the LED, channel by channel
+    PB_ADD          //!< sum of both, saturated
+} particle_blend_t;
+
+/*! Precomputed colours, the first one is at the far end of the particle and the last one right at its position */
+typedef struct ParticleRamp
+{
+    const ws2811_led_t* colors;
+    int steps;
+} particle_ramp_t;
+
+/*!
+ * Pool of LEDs moving over the geometry, in structure of arrays so that one pass updates all of them.
+ *
+ * A particle sits `distance` (0 to 1) of the way from `origin` to `next_stop`, which is the neighbour of `origin`
+ * in `direction`. It is drawn as a body that stretches `ahead` LEDs in the direction of movement and `behind`
+ * LEDs against it, each part coloured by its ramp according to the distance from the particle position:
+ *   behind (3 LEDs)      ahead (1 LED)
+ *   o------o------o---*---o            * is the particle, o are LEDs
+ * A particle without ramps is not drawn by `Particles_render`, the mode draws it itself
+ */
+typedef struct Particles
+{
+    int capacity;
+    int n;                          //!< particles 0 .. n - 1 are in use
+    //movement
+    int16_t* origin;
+    int16_t* next_stop;
+    int16_t* destination;           //!< where to stop when `stop_at_destination` is set, -1 for nowhere
+    int16_t* home;                  //!< where the particle was added, it starts again from here when `respawn` is set
+    uint8_t* direction;             //!< dir_t
+    uint8_t* is_alive;              //!< dead particles are neither moved nor drawn, their slots stay
+    uint8_t* is_moving;
+    uint8_t* stop_at_destination;
+    uint8_t* respawn;               //!< when the particle cannot move any further, it starts again from `home`
+    float* distance;                //!< from origin, 0 to 1
+    float* speed;                   //!< in LEDs per second
+    float* acceleration;            //!< in LEDs per second squared
+    float* move_chance;             //!< probability that the particle moves in a frame, 1 moves smoothly
+    //rendering
+    float* behind;                  //!< length of the body against the direction of movement, in LEDs
+    float* ahead;                   //!< length of the body in the direction of movement
+    particle_ramp_t* behind_ramp;
+    particle_ramp_t* ahead_ramp;
+    uint8_t* blend;                 //!< particle_blend_t
+} particles_t;
+
+/*! @returns 1 on success, 0 when out of memory */
+int Particles_init(particles_t* particles, int capacity);
+
+void Particles_free(particles_t* particles);
+
+/*! @brief Remove all particles, nothing is freed */
+void Particles_clear(particles_t* particles);
+
+/*!
+ * @brief Add a moving particle without a body, the caller sets the rest of the fields it needs
+ * @returns index of the particle, -1 when the pool is full
+ */
+int Particles_add(particles_t* particles, int origin, dir_t direction, float speed);
+
+/*! @brief Accelerate and move all living particles by `time_delta` ns over the geometry */
+void Particles_update(particles_t* particles, const geometry_t* geometry, uint64_t time_delta);
+
+/*! @brief Draw the bodies of all living particles that have ramps, in the order they were added */
+void Particles_render(const particles_t* particles, const geometry_t* geometry, ws2811_led_t* leds);
+
+#endif /* __PARTICLES_H__ */
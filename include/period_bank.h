@@ -0,0 +1,41 @@
+#ifndef __PERIOD_BANK_H__
+#define __PERIOD_BANK_H__
+
+/*!
+ * Bank of oscillators with randomized periods, in structure of arrays so that all of them are evaluated
+ * in one pass. Phase is in turns (0 to 1) and it is advanced by the frame time, there is no clock to read.
+ * The length of every period is basePeriod +- 0.5 * periodRange, a new one is rolled when the phase wraps
+ * and it starts where the old one ended, the same as the old per-LED `get_angle` did
+ */
+typedef struct PeriodBank
+{
+    int n;
+    float* phase;               //!< position in the current period, 0 to 1
+    float* step;                //!< phase per ms, i.e. 1 / length of the current period
+    float* shift;               //!< constant phase shift in turns, 0 to 1
+    unsigned long base_period;  //!< in ms
+    unsigned long period_range; //!< in ms
+} period_bank_t;
+
+/*!
+ * @brief Allocate the bank and roll the first period of every oscillator
+ * @param shift     phase shift of every oscillator in radians, may be NULL for no shift
+ * @returns         1 on success, 0 when out of memory
+ */
+int PeriodBank_init(period_bank_t* bank, int n, unsigned long base_period, unsigned long period_range, const double* shift);
+
+/*! @brief Move all oscillators by `time_delta` ns, oscillators that finished their period roll a new one */
+void PeriodBank_advance(period_bank_t* bank, uint64_t time_delta);
+
+/*!
+ * @brief out[i] = add + mul * cos(2 * pi * (phase[i] + shift[i])), cosine is a polynomial good to 1e-5.
+ *        Uses NEON or SSE2 when available
+ */
+void PeriodBank_cos(const period_bank_t* bank, float add, float mul, float* out);
+
+/*! @returns phase of oscillator `i` including its shift, in turns from 0 to 1, e.g. for a lookup table */
+float PeriodBank_turns(const period_bank_t* bank, int i);
+
+void PeriodBank_free(period_bank_t* bank);
+
+#endif /* __PERIOD_BANK_H__ */
@@ -14,8 +14,10 @@ typedef struct PerlinSource
 	struct noise_t* noise[PERLIN_FREQ_N];
 	int noise_freq[PERLIN_FREQ_N];
 	double noise_weight[PERLIN_FREQ_N];
+	int audio_reactive;					//!< when 1, brightness pulses with the beat of the captured sound
 } PerlinSource;
 
 extern PerlinSource perlin_source;
+extern struct ArgOptions arg_options;
 
 #endif /* __PERLIN_SOURCE_H__ */
@@ -10,6 +10,8 @@ enum PulseModes
 };
 
 void PulseObject_update(int pi);
+/*! @brief Update the colours of `n` objects in one pass, the callbacks of finished pulses run as they are reached */
+void PulseObject_update_all(const int16_t* objects, int n);
 
 void PulseObject_init(int pi, double amp, enum PulseModes pm, int repetitions, int period, double phase, double led_phase, double spec, void(*on_end)(int));
 void PulseObject_set_color_all(int pi, int color_index_0, int color_index_1, int next_color, int length);
@@ -17,5 +19,11 @@ void PulseObject_set_color(int pi, int color0, int color1, int color_next, int l
 
 void PulseObject_init_steady(int pi, int color_index, int length);
 
+/*! @brief Forget the shared colour ramps, the gradient colours may change when a new game starts */
+void PulseObject_clear_ramps();
+
+/*! Free the colours of all objects */
+void PulseObject_free_all();
+
 
 #endif  /* __PULSE_OBJECT_H__ */
@@ -0,0 +1,72 @@
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#define REPLAY_FLUSH_FRAMES    50     //< the recording is flushed this often, so a killed session loses at most a second
+#define REPLAY_MAX_REPORTED    10     //< only this many diverged inputs are printed, all of them are counted
+
+enum ReplayMode
+{
+    RM_OFF,
+    RM_RECORD,  //!< inputs are passed through and written to the file
+    RM_PLAY     //!< inputs are read from the file, controllers, listener and sound card are not touched
+};
+
+/*! Everything that is needed to start the session again, the rest comes frame by frame */
+typedef struct ReplayHeader
+{
+    uint32_t seed;              //!< of the random generator
+    int source_type;            //!< enum SourceType the session started with
+    int led_count;
+    int time_speed;
+    uint64_t frame_time;        //!< in us, frame times are stored relative to it
+    uint64_t start_ns;          //!< time of the source init
+} replay_header_t;
+
+/*!
+ * @brief Record the session to `filename`. Call before the source is initialized, the games look for
+ *        their controllers during the init. The file is binary: the header followed by the frames, each
+ *        of them is the frame time and the inputs the frame read, in variable length integers
+ */
+void Replay_start_recording(const char* filename, const replay_header_t* header);
+
+/*!
+ * @brief Load the recording from `filename` and fill in `header`, the caller starts the session with it
+ *        and then calls `Replay_next_frame` instead of reading the clock
+ */
+void Replay_start_playback(const char* filename, replay_header_t* header);
+
+enum ReplayMode Replay_get_mode();
+
+/*! @brief Start a new frame of the recording, `time_delta` is in ns */
+void Replay_write_frame(uint64_t time_delta);
+
+/*!
+ * @brief Move to the next recorded frame
+ * @returns 1 and the frame time in `time_delta` (ns), 0 at the end of the recording
+ */
+int Replay_next_frame(uint64_t* time_delta);
+
+/*! @brief Record a call of `Controller_get_button`, including the ones that read nothing */
+void Replay_write_button(int player, int result, int button, int state);
+/*! @returns what the same call of `Controller_get_button` returned in the recorded frame */
+int Replay_read_button(int player, int* button, int* state);
+
+void Replay_write_players(int n_players);
+int Replay_read_players();
+
+/*! @brief Record a message from the listener, NULL (no message) is not recorded */
+void Replay_write_message(const char* msg);
+/*! @returns next message of the frame, allocated as by `Listener_poll_message`, or NULL when there is none */
+char* Replay_read_message();
+
+/*! @brief Record position of the song returned by `SoundPlayer_play` */
+void Replay_write_sound(long position);
+long Replay_read_sound();
+
+/*!
+ * @brief Close the file and print the summary
+ * @returns number of inputs that were asked for differently than recorded, i.e. the run has diverged
+ */
+int Replay_finish();
+
+#endif /* __REPLAY_H__ */
@@ -12,7 +12,8 @@ void SourceConfig_add_color(char* source_name, SourceColors* source_colors);
 void SourceConfig_destruct();
 void SourceColors_destruct(SourceColors* source_colors);
 
-void SourceManager_init(enum SourceType source_type, int led_count, int time_speed, uint64_t cur_time);
+/*! @param seed   every source gets its own random stream derived from it, see `Random_seed` */
+void SourceManager_init(enum SourceType source_type, int led_count, int time_speed, uint32_t seed, uint64_t cur_time);
 int (*SourceManager_update_leds)(int, ws2811_t*);
 void (*SourceManager_destruct_source)();
 void (*SourceManager_process_message)(const char*);
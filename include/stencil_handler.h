@@ -13,6 +13,20 @@ enum StencilFlags
 
 
 void Stencil_init(enum GameModes current_mode);
+
+/*! @brief Forget the stencil of the previous frame */
+void Stencil_clear();
+
+/*!
+ * @brief Claim the LEDs covered by the object this frame, including its trail, and run the handlers of the objects
+ *        it collides with, once for every object in the way
+ */
 void Stencil_stencil_test(int object_index, int stencil_flag);
 
+/*!
+ * @param stencil   flag of the object, may be NULL
+ * @returns         index of the object that owns `led` in the stencil, -1 if there is none
+ */
+int Stencil_get_object(int led, enum StencilFlags* stencil);
+
 #endif /* __STENCIL_HANDLER_H__ */
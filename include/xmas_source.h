@@ -14,6 +14,7 @@ typedef enum XMAS_MODE
 	XM_FIREWORKS,
 	XM_SLEDGES,
 	XM_VALERIA,
+	XM_RIPPLES,
 	N_XMAS_MODES
 } XMAS_MODE_t;
 
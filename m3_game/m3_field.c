@@ -27,7 +27,12 @@
 const int C_MATCH_3_LENGTH = 3;
 
 
-jewel_t field[C_MAX_FIELD_LENGTH];
+//! Jewels are kept in a gap buffer: field indices below gap_start are stored as they are, the rest is stored after
+//! the gap. Jewels are inserted and removed at the gap, moving the gap costs only the jewels between the old and the
+//! new position, so the edits around one place (e.g. cascade of collapses) do not shift the whole field
+static jewel_t field[C_MAX_FIELD_LENGTH];
+static int gap_start = 0;
+static int gap_end = C_MAX_FIELD_LENGTH;
 int field_length = 0;
 double speed_bias = 1.;
 double round_collapse_time;
@@ -52,7 +57,8 @@ typedef struct TSegment {
     int start;      //!< this is index into field
     int length;
     double shift;   //!< offset againt start, first led of the field is start + shift
-    match3_BulletInfo_t bullets[N_MAX_BULLETS];
+    int first_bullet;   //!< index into bullet_pool, bullets of the segment are chained by their `next`
+    int last_bullet;
     int n_bullets;
     int debug;
     enum ESegmentType segment_type;
@@ -62,9 +68,30 @@ typedef struct TSegment {
     };
 } segment_t;
 
-segment_t segments[N_MAX_SEGMENTS];
+//! Segments are allocated in blocks of N_SEGMENTS_BLOCK and listed in the order along the field. Inserting and
+//! deleting segment moves only the pointers, the segments themselves stay where they are
+static segment_t** segment_blocks;
+static int n_segment_blocks = 0;
+static int capacity_segment_blocks = 0;
+static segment_t** free_segments;
+static int n_free_segments = 0;
+static int capacity_free_segments = 0;
+static segment_t** segments;
+static int capacity_segments = 0;
 int n_segments = 0;
 
+//! Bullets in the segments, shared by all segments and referenced by index, released bullets are chained from
+//! free_bullet
+typedef struct TSegmentBullet {
+    match3_BulletInfo_t info;
+    int next;
+} segment_bullet_t;
+
+static segment_bullet_t* bullet_pool;
+static int n_pool_bullets = 0;
+static int capacity_pool_bullets = 0;
+static int free_bullet = -1;
+
 struct {
     int left_jewel_id;
     int right_jewel_id;
@@ -76,17 +103,152 @@ int n_unswaps = 0;
 static double calculate_segment_speed(int segment);
 static jewel_t make_jewel(jewel_type type);
 
+static inline jewel_t* jewel_at(int field_index)
+{
+    return field + field_index + ((field_index < gap_start) ? 0 : gap_end - gap_start);
+}
+
+//! @brief Move the gap so that it starts at \p field_index
+static void move_gap(int field_index)
+{
+    if (field_index < gap_start)
+    {
+        int n = gap_start - field_index;
+        memmove(field + gap_end - n, field + field_index, n * sizeof(jewel_t));
+        gap_start -= n;
+        gap_end -= n;
+    }
+    else if (field_index > gap_start)
+    {
+        int n = field_index - gap_start;
+        memmove(field + gap_start, field + gap_end, n * sizeof(jewel_t));
+        gap_start += n;
+        gap_end += n;
+    }
+}
+
+static void remove_jewels(int field_index, int count)
+{
+    move_gap(field_index);
+    gap_end += count;
+    field_length -= count;
+}
+
+//! @brief Jewel at \p field_index and higher will be shifted right. If we are at the max field length, the last jewel
+//! is dropped
+static void insert_jewel(int field_index, jewel_t jewel)
+{
+    if (field_length == C_MAX_FIELD_LENGTH - 1)
+        remove_jewels(field_length - 1, 1);
+    move_gap(field_index);
+    field[gap_start++] = jewel;
+    field_length++;
+}
+
+//! @brief Empty the field, the jewels 0 .. \p length - 1 are then filled directly, they are all before the gap
+static void reset_field(int length)
+{
+    field_length = length;
+    gap_start = length;
+    gap_end = C_MAX_FIELD_LENGTH;
+}
+
+static void* reserve(void* items, int* capacity, int needed, size_t item_size)
+{
+    if (needed <= *capacity)
+        return items;
+    int new_capacity = (*capacity > 0) ? *capacity * 2 : 16;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+    items = realloc(items, new_capacity * item_size);
+    if (items == NULL)
+    {
+        fprintf(stderr, "Out of memory for Match3 field\n");
+        exit(-4);
+    }
+    *capacity = new_capacity;
+    return items;
+}
+
+//! @brief Put all segments of \p block to the free list, the list has room for every allocated segment, so that
+//! delete_segment never has to grow it
+static void free_block(segment_t* block)
+{
+    free_segments = reserve(free_segments, &capacity_free_segments, n_segment_blocks * N_SEGMENTS_BLOCK, sizeof(segment_t*));
+    for (int si = N_SEGMENTS_BLOCK - 1; si >= 0; --si)
+        free_segments[n_free_segments++] = &block[si];
+}
+
+static segment_t* alloc_segment(void)
+{
+    if (n_free_segments == 0)
+    {
+        segment_t* block = malloc(N_SEGMENTS_BLOCK * sizeof(segment_t));
+        if (block == NULL)
+        {
+            fprintf(stderr, "Out of memory for Match3 field\n");
+            exit(-4);
+        }
+        segment_blocks = reserve(segment_blocks, &capacity_segment_blocks, n_segment_blocks + 1, sizeof(segment_t*));
+        segment_blocks[n_segment_blocks++] = block;
+        free_block(block);
+    }
+    return free_segments[--n_free_segments];
+}
+
+//! @brief Make room for \p count new segments after \p segment, the segments after it keep their content
+static void insert_segments(int segment, int count)
+{
+    segments = reserve(segments, &capacity_segments, n_segments + count, sizeof(segment_t*));
+    memmove(segments + segment + 1 + count, segments + segment + 1, (n_segments - segment - 1) * sizeof(segment_t*));
+    for (int si = segment + 1; si <= segment + count; ++si)
+        segments[si] = alloc_segment();
+    n_segments += count;
+}
+
+//! @brief Release all segments and bullets, the memory is kept for the next level
+static void reset_segments(void)
+{
+    n_free_segments = 0;
+    for (int block = 0; block < n_segment_blocks; ++block)
+        free_block(segment_blocks[block]);
+    n_segments = 0;
+    n_pool_bullets = 0;
+    free_bullet = -1;
+}
+
+static int alloc_bullet(void)
+{
+    if (free_bullet > -1)
+    {
+        int bullet = free_bullet;
+        free_bullet = bullet_pool[bullet].next;
+        return bullet;
+    }
+    bullet_pool = reserve(bullet_pool, &capacity_pool_bullets, n_pool_bullets + 1, sizeof(segment_bullet_t));
+    return n_pool_bullets++;
+}
+
+static void release_bullets(segment_t* segment)
+{
+    if (segment->n_bullets == 0)
+        return;
+    bullet_pool[segment->last_bullet].next = free_bullet;
+    free_bullet = segment->first_bullet;
+    segment->n_bullets = 0;
+}
+
 void Segments_print_info(int segment)
 {
     ASSERT_M3(segment < n_segments, (void)0);
-    printf("Segment id: %i, shift: %f, start: %i, length: %i ", segment, segments[segment].shift, segments[segment].start, segments[segment].length);
-    switch (segments[segment].segment_type)
+    printf("Segment id: %i, shift: %f, start: %i, length: %i ", segment, segments[segment]->shift, segments[segment]->start, segments[segment]->length);
+    switch (segments[segment]->segment_type)
     {
     case ST_MOVING:
-        printf("speed: %f, discomb.: %i\n", segments[segment].moving.speed, segments[segment].moving.discombobulation);
+        printf("speed: %f, discomb.: %i\n", segments[segment]->moving.speed, segments[segment]->moving.discombobulation);
         break;
     case ST_COLLAPSING:
-        printf("collapse: %f\n", segments[segment].collapsing.collapse_progress);
+        printf("collapse: %f\n", segments[segment]->collapsing.collapse_progress);
         break;
     }
 }
@@ -101,7 +263,7 @@ int Segments_get_next_moving(int segment)
     {
         if (++segment == n_segments)
             return -1;
-    } while (segments[segment].segment_type != ST_MOVING);
+    } while (segments[segment]->segment_type != ST_MOVING);
     return segment;
 }
 
@@ -112,7 +274,7 @@ int Segments_get_prev_moving(int segment)
     do {
         if (--segment < 0) 
             return -1;
-    } while (segments[segment].segment_type != ST_MOVING);
+    } while (segments[segment]->segment_type != ST_MOVING);
     return segment;
 }
 
@@ -122,33 +284,33 @@ int Segments_get_next_collapsing(int segment)
     do {
         if (++segment == n_segments)
             return -1;
-    } while (segments[segment].segment_type != ST_COLLAPSING);
+    } while (segments[segment]->segment_type != ST_COLLAPSING);
     return segment;
 }
 
 double Segments_get_position(int segment)
 {
     ASSERT_M3(segment < n_segments, 0);
-    return segments[segment].shift;
+    return segments[segment]->shift;
 }
 
 int Segments_get_length(int segment)
 {
     ASSERT_M3(segment < n_segments, 1);
-    return segments[segment].length;
+    return segments[segment]->length;
 }
 
 int Segments_get_direction(int segment)
 {
     ASSERT_M3(segment < n_segments, 0);
-    ASSERT_M3(segments[segment].segment_type == ST_MOVING, 0);
-    if (segments[segment].moving.speed > 0)
+    ASSERT_M3(segments[segment]->segment_type == ST_MOVING, 0);
+    if (segments[segment]->moving.speed > 0)
     {
         //moving left to right, the hole appears on right and travels to left, we shift jewels that are after the hole
         //offset is increasing
         return +1;
     }
-    else if (segments[segment].moving.speed < 0)
+    else if (segments[segment]->moving.speed < 0)
     {
         //moving right to left, hole appears on left and travels right, we shift jewels that are before hole
         //offset is decreasing
@@ -159,38 +321,38 @@ int Segments_get_direction(int segment)
 
 jewel_t Segments_get_jewel(int segment, int position)
 {
-    ASSERT_M3(segment < n_segments, field[segments[0].start]);
-    ASSERT_M3(position < Segments_get_length(segment), field[segments[segment].start]);
-    return field[segments[segment].start + position];
+    ASSERT_M3(segment < n_segments, *jewel_at(segments[0]->start));
+    ASSERT_M3(position < Segments_get_length(segment), *jewel_at(segments[segment]->start));
+    return *jewel_at(segments[segment]->start + position);
 }
 
 jewel_type Segments_get_jewel_type(int segment, int position)
 {
     ASSERT_M3(segment < n_segments, (jewel_type)0);
     ASSERT_M3(position < Segments_get_length(segment), (jewel_type)0);
-    return field[segments[segment].start + position].type;
+    return jewel_at(segments[segment]->start + position)->type;
 }
 
 jewel_type Segments_get_last_jewel_type(int segment)
 {
     ASSERT_M3(segment < n_segments, (jewel_type)0);
     int segment_length = Segments_get_length(segment);
-    int pos = segments[segment].start + segment_length - 1;
-    return (pos >= 0) ? field[pos].type : 0xFF;
+    int pos = segments[segment]->start + segment_length - 1;
+    return (pos >= 0) ? jewel_at(pos)->type : 0xFF;
 }
 
 int Segments_get_field_index(int segment, int position)
 {
-    ASSERT_M3(segment < n_segments, segments[0].start);
-    ASSERT_M3(position < Segments_get_length(segment), segments[segment].start);
-    return segments[segment].start + position;
+    ASSERT_M3(segment < n_segments, segments[0]->start);
+    ASSERT_M3(position < Segments_get_length(segment), segments[segment]->start);
+    return segments[segment]->start + position;
 }
 
 static int Field_get_segment(int field_index)
 {
     for (int si = 0; si < n_segments; ++si)
     {
-        int start = segments[si].start;
+        int start = segments[si]->start;
         int len = Segments_get_length(si);
         if (field_index >= start && field_index < start + len)
             return si;
@@ -202,64 +364,74 @@ int Segments_get_jewel_id(int segment, int position)
 {
     ASSERT_M3(segment < n_segments, -1);
     ASSERT_M3(position < Segments_get_length(segment), -1);
-    return field[Segments_get_field_index(segment, position)].unique_id;
+    return jewel_at(Segments_get_field_index(segment, position))->unique_id;
 }
 
 void Segments_add_shift(int segment, int amount)
 {
     ASSERT_M3(segment < n_segments, (void)0);
     printf("Shifting segment %i by %i\n", segment, amount);
-    segments[segment].shift += amount;
+    segments[segment]->shift += amount;
 }
 
 void Segments_reset_bullets(int segment)
 {
     ASSERT_M3(segment < n_segments, (void)0);
-    segments[segment].n_bullets = 0;
+    release_bullets(segments[segment]);
 }
 
 void Segments_add_bullet(int segment, int bullet_index, int segment_position)
 {
     ASSERT_M3(segment < n_segments, (void)0);
-    int n = segments[segment].n_bullets;
-    segments[segment].bullets[n].bullet_index = bullet_index;
-    segments[segment].bullets[n].segment_position = segment_position;
-    segments[segment].n_bullets = n + 1;
+    int bullet = alloc_bullet();
+    bullet_pool[bullet].info.bullet_index = bullet_index;
+    bullet_pool[bullet].info.segment_position = segment_position;
+    bullet_pool[bullet].next = -1;
+    segment_t* s = segments[segment];
+    if (s->n_bullets == 0)
+        s->first_bullet = bullet;
+    else
+        bullet_pool[s->last_bullet].next = bullet;
+    s->last_bullet = bullet;
+    s->n_bullets++;
 }
 
 int Segments_get_n_bullets(int segment)
 {
     ASSERT_M3(segment < n_segments, (void)0);
-    return segments[segment].n_bullets;
+    return segments[segment]->n_bullets;
 }
 
 match3_BulletInfo_t Segments_get_bullet(int segment, int segment_bullet_index)
 {
     ASSERT_M3(segment < n_segments, (void)0);
-    ASSERT_M3(segment_bullet_index < segments[segment].n_bullets, (void)0);
-    return segments[segment].bullets[segment_bullet_index];
+    ASSERT_M3(segment_bullet_index < segments[segment]->n_bullets, (void)0);
+    int bullet = segments[segment]->first_bullet;
+    while (segment_bullet_index-- > 0)
+        bullet = bullet_pool[bullet].next;
+    return bullet_pool[bullet].info;
 }
 
 void Segments_set_discombobulation(int segment, int discombobulation)
 {
     ASSERT_M3(segment < n_segments, (void)0);
-    ASSERT_M3(segments[segment].segment_type == ST_MOVING, (void)0);
+    ASSERT_M3(segments[segment]->segment_type == ST_MOVING, (void)0);
     ASSERT_M3(discombobulation >= 0, (void)0);
-    segments[segment].moving.discombobulation = discombobulation;
+    segments[segment]->moving.discombobulation = discombobulation;
 }
 
 int Segments_get_discombobulation(int segment)
 {
     ASSERT_M3(segment < n_segments, 0);
-    ASSERT_M3(segments[segment].segment_type == ST_MOVING, 0);
-    return segments[segment].moving.discombobulation;
+    ASSERT_M3(segments[segment]->segment_type == ST_MOVING, 0);
+    return segments[segment]->moving.discombobulation;
 }
 
 double Segments_get_collapse_progress(int segment)
 {
     ASSERT_M3(segment < n_segments, 0.);
-    ASSERT_M3(segments[segment].segment_type == ST_COLLAPSING, 0.);
-    return segments[segment].collapsing.collapse_progress;
+    ASSERT_M3(segments[segment]->segment_type == ST_COLLAPSING, 0.);
+    return segments[segment]->collapsing.collapse_progress;
 }
 
 int Segments_get_hole_position(int segment)
@@ -325,9 +497,9 @@ static void collapse_segment(const int segment, const int position, const int co
         new_moving_index--;
     }
     int bullets_left = 0, bullets_collapsing = 0, bullets_right = 0;
-    for (int i = 0; i < Segments_get_n_bullets(segment); ++i)
+    for (int i = 0, bullet = segments[segment]->first_bullet; i < segments[segment]->n_bullets; ++i, bullet = bullet_pool[bullet].next)
     {
-        int pos = Segments_get_bullet(segment, i).segment_position;
+        int pos = bullet_pool[bullet].info.segment_position;
         if (pos < position - collapse_length)
             bullets_left++;
         else if (pos < position)
@@ -336,37 +508,35 @@ static void collapse_segment(const int segment, const int position, const int co
             bullets_right++;
     }
 
-    n_segments += n_inserts;
+    insert_segments(segment, n_inserts);
     //printf("N segments increased to %i\n", n_segments);
-    ASSERT_M3(n_segments <= N_MAX_SEGMENTS, (void)0); //TODO handle this situation
     for (int si = n_segments - 1; si > segment + n_inserts; --si)
     {
-        segments[si] = segments[si - n_inserts];
-        if(segments[si].segment_type == ST_MOVING)
-            segments[si].moving.speed = 0;
+        if(segments[si]->segment_type == ST_MOVING)
+            segments[si]->moving.speed = 0;
     }
 
     //if the hole is to the left of us, we have to shift position by one
     int hole_left = (hole_position < position - collapse_length) ? 1 : 0;
     segment_t collapsing_segment = {
-        .start = segments[segment].start + position - collapse_length,
+        .start = segments[segment]->start + position - collapse_length,
         .length = collapse_length,
-        .shift = floor(segments[segment].shift) + position - collapse_length + bullets_left + hole_left,
+        .shift = floor(segments[segment]->shift) + position - collapse_length + bullets_left + hole_left,
         .segment_type = ST_COLLAPSING,
         .collapsing.collapse_progress = 1.0,
         .debug = match3_game_source.cur_frame
     };
     if (collapse_index > segment) //the \p segment will be trimmed
     {
-        segments[segment].length = position - collapse_length;
-        segments[segment].moving.discombobulation = bullets_left;
+        segments[segment]->length = position - collapse_length;
+        segments[segment]->moving.discombobulation = bullets_left;
         if (hole_left)
         {
-            segments[segment].shift = floor(segments[segment].shift) + (double)(segments[segment].length - hole_position) / segments[segment].length;
+            segments[segment]->shift = floor(segments[segment]->shift) + (double)(segments[segment]->length - hole_position) / segments[segment]->length;
         }
         else
         {
-            segments[segment].shift = floor(segments[segment].shift);
+            segments[segment]->shift = floor(segments[segment]->shift);
         }
     }
     if (new_moving_index > 0) //new segment will be inserted to the right of the collapsing segment
@@ -376,25 +546,27 @@ static void collapse_segment(const int segment, const int position, const int co
         if (hole_position > position) new_segment_shift = (double)(segment_length - hole_position) / (segment_length - position);
 
         segment_t moving_segment = {
-            .start = segments[segment].start + position,
+            .start = segments[segment]->start + position,
             .length = segment_length - position,
-            .shift = trunc(segments[segment].shift) + position + bullets_left + bullets_collapsing + hole_left + new_segment_shift,
+            .shift = trunc(segments[segment]->shift) + position + bullets_left + bullets_collapsing + hole_left + new_segment_shift,
             .segment_type = ST_MOVING,
             .moving.speed = 0,
             .moving.discombobulation = bullets_right,
             .debug = match3_game_source.cur_frame
         };
-        segments[new_moving_index] = moving_segment;
+        *segments[new_moving_index] = moving_segment;
     }
-    segments[collapse_index] = collapsing_segment;
+    if (collapse_index == segment)
+        release_bullets(segments[segment]);
+    *segments[collapse_index] = collapsing_segment;
     if (new_moving_index > -1)
     {
         printf("New segment: ");
         Segments_print_info(new_moving_index);
         //double new_speed = calculate_segment_speed(new_moving_index);
-        //if (new_speed < 0.) segments[new_moving_index].shift += 1.;
+        //if (new_speed < 0.) segments[new_moving_index]->shift += 1.;
     }
-    printf("Collapsing segment delta %f: ", segments[collapse_index].shift - segments[segment].shift - segments[segment].length);
+    printf("Collapsing segment delta %f: ", segments[collapse_index]->shift - segments[segment]->shift - segments[segment]->length);
     Segments_print_info(collapse_index);
 }
 
@@ -403,13 +575,16 @@ static void collapse_segment(const int segment, const int position, const int co
 //! @param shift_length only necessary when shifting field before deleting segment, otherwise must be 0
 static void delete_segment(const int left_segment, int shift_length)
 {
-    //ASSERT_M3(segments[left_segment].segment_type == ST_COLLAPSING, (void)0); -- this is only true when removing collapsed, not when merging
-    for (int segment = left_segment; segment < n_segments - 1; ++segment)
+    //ASSERT_M3(segments[left_segment]->segment_type == ST_COLLAPSING, (void)0); -- this is only true when removing collapsed, not when merging
+    release_bullets(segments[left_segment]);
+    free_segments[n_free_segments++] = segments[left_segment];
+    memmove(segments + left_segment, segments + left_segment + 1, (n_segments - left_segment - 1) * sizeof(segment_t*));
+    n_segments--;
+    if (shift_length > 0)
     {
-        segments[segment] = segments[segment + 1];
-        segments[segment].start -= shift_length;
+        for (int segment = left_segment; segment < n_segments; ++segment)
+            segments[segment]->start -= shift_length;
     }
-    n_segments--;
     //printf("N segments decreasing to %i\n", n_segments);
 }
 
@@ -417,8 +592,8 @@ static void merge_segments(const int left_segment, int right_segment)
 {
     ASSERT_M3(left_segment < n_segments - 1, (void)0); //there must be at least one segment to the right
     ASSERT_M3(right_segment < n_segments, (void)0);
-    ASSERT_M3(segments[left_segment].segment_type == ST_MOVING, (void)0);
-    ASSERT_M3(segments[right_segment].segment_type == ST_MOVING, (void)0);
+    ASSERT_M3(segments[left_segment]->segment_type == ST_MOVING, (void)0);
+    ASSERT_M3(segments[right_segment]->segment_type == ST_MOVING, (void)0);
     ASSERT_M3(right_segment == Segments_get_next_moving(left_segment), (void)0);
 
     //the jewels in segment have to be continous, we might overwrite some collapsing segment, if that happens we will just delete it
@@ -429,18 +604,13 @@ static void merge_segments(const int left_segment, int right_segment)
     }
 
     //we have to shift jewels in the field so that the dead and collapsing jewel in the intervening segment are overwritten
-    int shift_length = segments[right_segment].start - segments[left_segment].start - Segments_get_length(left_segment);
+    int shift_length = segments[right_segment]->start - segments[left_segment]->start - Segments_get_length(left_segment);
     if (shift_length > 0)
     {
-        int start_pos = segments[right_segment].start - shift_length;
-        for (int fi = start_pos; fi < field_length - shift_length; ++fi)
-        {
-            field[fi] = field[fi + shift_length];
-        }
-        field_length -= shift_length;
+        remove_jewels(segments[right_segment]->start - shift_length, shift_length);
     }
     //new segment length will be total of the two
-    segments[left_segment].length += segments[right_segment].length;
+    segments[left_segment]->length += segments[right_segment]->length;
 
     //now we have to update start of all segments to the right, at the same time we also overwrite the right segment
     delete_segment(right_segment, shift_length);
@@ -452,7 +622,7 @@ static void merge_segments(const int left_segment, int right_segment)
 //! @return probably nothing interesting
 static int evaluate_field(const int segment, const int position)
 {
-    ASSERT_M3(segments[segment].segment_type == ST_MOVING, (void)0);
+    ASSERT_M3(segments[segment]->segment_type == ST_MOVING, (void)0);
     jewel_type type = Segments_get_jewel_type(segment, position);
     int segment_length = Segments_get_length(segment);
 
@@ -493,35 +663,34 @@ void Field_insert_and_evaluate(const int insert_segment, const int position, jew
 {
     ASSERT_M3(insert_segment < n_segments, (void)0);
     ASSERT_M3(position < Segments_get_length(insert_segment), (void)0);
-    ASSERT_M3(segments[insert_segment].segment_type == ST_MOVING, (void)0);
+    ASSERT_M3(segments[insert_segment]->segment_type == ST_MOVING, (void)0);
 
     printf("inserting into %i, pos %i\n", insert_segment, position);
     Segments_print_info(insert_segment);
-    field_length += (field_length == C_MAX_FIELD_LENGTH - 1) ? 0 : 1; //if we are at the max field length, the last jewel will be simply overwritten
-    int fi_insert = Segments_get_field_index(insert_segment, position);
-    for (int fi = field_length - 1; fi > fi_insert; --fi)
-    {
-        field[fi] = field[fi - 1];
-    }
-    field[fi_insert] = make_jewel(jewel_type);
-    segments[insert_segment].length++;
+    insert_jewel(Segments_get_field_index(insert_segment, position), make_jewel(jewel_type));
+    segments[insert_segment]->length++;
     for (int segment = insert_segment + 1; segment < n_segments; ++segment)
     {
-        segments[segment].start += 1;
+        segments[segment]->start += 1;
     }
-    segments[insert_segment].moving.discombobulation--;
+    segments[insert_segment]->moving.discombobulation--;
     int deleting = 0;
-    for (int sbi = 0; sbi < segments[insert_segment].n_bullets; ++sbi)
+    segment_t* s = segments[insert_segment];
+    for (int sbi = 0, prev = -1, bullet = s->first_bullet; sbi < s->n_bullets; ++sbi, prev = bullet, bullet = bullet_pool[bullet].next)
     {
-        if (segments[insert_segment].bullets[sbi].bullet_index == bullet_index)
-        {
-            deleting = 1;
-            segments[insert_segment].n_bullets--;
-        }
-        if (deleting)
-        {
-            segments[insert_segment].bullets[sbi] = segments[insert_segment].bullets[sbi + 1];
-        }
+        if (bullet_pool[bullet].info.bullet_index != bullet_index)
+            continue;
+        if (prev == -1)
+            s->first_bullet = bullet_pool[bullet].next;
+        else
+            bullet_pool[prev].next = bullet_pool[bullet].next;
+        if (bullet == s->last_bullet)
+            s->last_bullet = prev;
+        bullet_pool[bullet].next = free_bullet;
+        free_bullet = bullet;
+        s->n_bullets--;
+        deleting = 1;
+        break;
     }
     assert(deleting);
     //match3_announce("THUD (bullet into jewel)");
@@ -534,11 +703,13 @@ static void swap_jewels(const int swap_segment, const int left_position, int* le
 {
     int left_index = Segments_get_field_index(swap_segment, left_position);
     int right_index = Segments_get_field_index(swap_segment, left_position + 1);
-    *left_id = field[left_index].unique_id;
-    *right_id = field[right_index].unique_id;
-    jewel_t tmp = field[left_index];
-    field[left_index] = field[right_index];
-    field[right_index] = tmp;
+    jewel_t* left = jewel_at(left_index);
+    jewel_t* right = jewel_at(right_index);
+    *left_id = left->unique_id;
+    *right_id = right->unique_id;
+    jewel_t tmp = *left;
+    *left = *right;
+    *right = tmp;
 }
 
 static int swap_jewels_by_id(const int left_id, const int right_id)
@@ -547,17 +718,18 @@ static int swap_jewels_by_id(const int left_id, const int right_id)
     int right_index = -1;
     for (int i = 0; i < field_length; ++i)
     {
-        if (field[i].unique_id == left_id) left_index = i;
-        if (field[i].unique_id == right_id) right_index = i;
+        int id = jewel_at(i)->unique_id;
+        if (id == left_id) left_index = i;
+        if (id == right_id) right_index = i;
         if (left_index > -1 && right_index > -1) break;
     }
     if (left_index > -1 && right_index > -1)
     {
         if (Field_get_segment(left_index) != Field_get_segment(right_index))
             return 0; //the jewels are now in different segments, one of them si probably collapsing
-        jewel_t tmp = field[left_index];
-        field[left_index] = field[right_index];
-        field[right_index] = tmp;
+        jewel_t tmp = *jewel_at(left_index);
+        *jewel_at(left_index) = *jewel_at(right_index);
+        *jewel_at(right_index) = tmp;
         return 1;
     }
     return 0; //one of the jewels was probably somehow destroyed in the meantime
@@ -566,8 +738,8 @@ static int swap_jewels_by_id(const int left_id, const int right_id)
 int Field_swap_and_evaluate(const int swap_segment, const int left_position)
 {
     ASSERT_M3(swap_segment < n_segments, (void)0);
-    ASSERT_M3(left_position < segments[swap_segment].length - 1, (void)0);
-    if (field[left_position].type == field[left_position + 1].type)
+    ASSERT_M3(left_position < segments[swap_segment]->length - 1, (void)0);
+    if (jewel_at(left_position)->type == jewel_at(left_position + 1)->type)
     {
         printf("Cannot pretend to swap jewels of the same type");
         return  -1;
@@ -592,16 +764,16 @@ int Field_swap_and_evaluate(const int swap_segment, const int left_position)
 
 static void set_segment_speed(int segment, double target_speed, double time_delta)
 {
-    ASSERT_M3(segments[segment].segment_type == ST_MOVING, (void)0);
-    if (segments[segment].moving.speed == target_speed)
+    ASSERT_M3(segments[segment]->segment_type == ST_MOVING, (void)0);
+    if (segments[segment]->moving.speed == target_speed)
         return;
     double max_change = match3_config.max_accelaration * time_delta;
     //printf("Max change %f\n", max_change);
-    segments[segment].moving.speed = (segments[segment].moving.speed < target_speed) ?
-        fmin(target_speed, segments[segment].moving.speed + max_change) :
-        fmax(target_speed, segments[segment].moving.speed - max_change);
-    if (segments[segment].moving.speed == 0)
-        segments[segment].shift = floor(segments[segment].shift);
+    segments[segment]->moving.speed = (segments[segment]->moving.speed < target_speed) ?
+        fmin(target_speed, segments[segment]->moving.speed + max_change) :
+        fmax(target_speed, segments[segment]->moving.speed - max_change);
+    if (segments[segment]->moving.speed == 0)
+        segments[segment]->shift = floor(segments[segment]->shift);
 }
 
 static double calculate_segment_speed(int segment)
@@ -657,12 +829,12 @@ int Segments_update(void)
     //update collapsing segments
     for (int segment = n_segments - 1; segment >= 0; --segment)
     {
-        if (segments[segment].segment_type != ST_COLLAPSING)
+        if (segments[segment]->segment_type != ST_COLLAPSING)
             continue;
-        segments[segment].collapsing.collapse_progress -= time_delta / round_collapse_time;
-        if (segments[segment].collapsing.collapse_progress < 0)
+        segments[segment]->collapsing.collapse_progress -= time_delta / round_collapse_time;
+        if (segments[segment]->collapsing.collapse_progress < 0)
         {
-            printf("Removing segment %i, length is %i\n", segment, segments[segment].length);
+            printf("Removing segment %i, length is %i\n", segment, segments[segment]->length);
             delete_segment(segment, 0);
         }
         else
@@ -680,18 +852,18 @@ int Segments_update(void)
     }
 
     //check speed of all segments and update as needed
-    int last_segment_old_pos = floor(segments[0].shift);
+    int last_segment_old_pos = floor(segments[0]->shift);
     for (int segment = 0; segment < n_segments; ++segment)
     {
-        if (segments[segment].segment_type != ST_MOVING)
+        if (segments[segment]->segment_type != ST_MOVING)
             continue;
         double target_speed = calculate_segment_speed(segment) * speed_bias;
         set_segment_speed(segment, target_speed, time_delta);
-        if (segments[segment].moving.speed == 0)
+        if (segments[segment]->moving.speed == 0)
             continue;
-        segments[segment].shift += segments[segment].moving.speed * time_delta;
+        segments[segment]->shift += segments[segment]->moving.speed * time_delta;
     }
-    if (last_segment_old_pos != floor(segments[0].shift))
+    if (last_segment_old_pos != floor(segments[0]->shift))
     {
         SoundPlayer_play(SE_M3_Tick);
     }
@@ -700,7 +872,7 @@ int Segments_update(void)
     int segment = n_segments - 1;
     while (segment > 0)
     {
-        if (segments[segment].segment_type != ST_MOVING)
+        if (segments[segment]->segment_type != ST_MOVING)
         {
             segment--;
             continue;
@@ -715,9 +887,9 @@ int Segments_update(void)
         double visual_distance = floor(Segments_get_position(segment)) - floor(Segments_get_position(left_segment)) - left_length;
         double real_distance = Segments_get_position(segment) - Segments_get_position(left_segment) - left_length;
         //if the left segment is moving right, or right segment is moving left, we have to decrease the visual distance by one in each case
-        //if (segments[segment].moving.speed < 0) visual_distance -= 1;
-        if (segments[left_segment].moving.speed > 0) visual_distance -= 1;
-        if (segments[left_segment].moving.speed > 0) real_distance -= 1;
+        //if (segments[segment]->moving.speed < 0) visual_distance -= 1;
+        if (segments[left_segment]->moving.speed > 0) visual_distance -= 1;
+        if (segments[left_segment]->moving.speed > 0) real_distance -= 1;
         if (visual_distance < 2.)
         {
             //printf("Distance between %i and %i is %f (real) %f\n", left_segment, segment, visual_distance, real_distance);
@@ -775,14 +947,15 @@ static void init_jewel_colors(int n_gem_colours, int offset)
 
 static void make_initial_segment(double start_offset)
 {
-    segments[0].start = 0;
-    segments[0].shift = start_offset;
-    segments[0].length = field_length;
-    segments[0].segment_type = ST_MOVING;
-    segments[0].moving.speed = match3_config.normal_forward_speed;
-    segments[0].moving.discombobulation = 0;
-    segments[0].n_bullets = 0;
-    n_segments = 1;
+    reset_segments();
+    insert_segments(-1, 1);
+    segments[0]->start = 0;
+    segments[0]->shift = start_offset;
+    segments[0]->length = field_length;
+    segments[0]->segment_type = ST_MOVING;
+    segments[0]->moving.speed = match3_config.normal_forward_speed;
+    segments[0]->moving.discombobulation = 0;
+    segments[0]->n_bullets = 0;
 }
 
 void Field_init_with_clue(const jewel_type field_def[], const int def_length)
@@ -790,7 +963,7 @@ void Field_init_with_clue(const jewel_type field_def[], const int def_length)
     init_jewel_colors(6, 0);
     speed_bias = 1;
     round_collapse_time = match3_config.clue_collapse_time;
-    field_length = def_length;
+    reset_field(def_length);
     for (int fi = 0; fi < field_length; ++fi)
     {
         field[fi] = make_jewel(N_GEM_COLORS - 1 - field_def[fi]);
@@ -804,7 +977,7 @@ void Field_init(match3_LevelDefinition_t level_definition)
     assert(level_definition.field_length <= C_MAX_FIELD_LENGTH);
     round_collapse_time = match3_config.collapse_time;
     init_jewel_colors(level_definition.n_gem_colours, 30);
-    field_length = level_definition.field_length;
+    reset_field(level_definition.field_length);
     speed_bias = level_definition.speed_bias;
     double same_gem_bias = level_definition.same_gem_bias;
     jewel_type last_type = (jewel_type)(random_01() * (double)level_definition.n_gem_colours);
@@ -827,5 +1000,16 @@ jewel_type Field_get_last_match(void)
 
 void Field_destruct(void)
 {
-    //free(field);
+    for (int block = 0; block < n_segment_blocks; ++block)
+        free(segment_blocks[block]);
+    free(segment_blocks);
+    free(free_segments);
+    free(segments);
+    free(bullet_pool);
+    segment_blocks = free_segments = segments = NULL;
+    bullet_pool = NULL;
+    n_segment_blocks = capacity_segment_blocks = n_free_segments = capacity_free_segments = capacity_segments = 0;
+    n_pool_bullets = capacity_pool_bullets = 0;
+    n_segments = 0;
+    free_bullet = -1;
 }
@@ -102,7 +102,7 @@ void RGM_DDR_clear()
 
 void RGM_DDR_init()
 {
-    srand(100);
+    Random_seed(&rad_game_source.basic_source.random, 100); //the same notes in every game
     int field_len = rad_game_source.basic_source.n_leds / rad_game_source.n_players; //for 200 leds and 3 player = 66
     int offset = (rad_game_source.basic_source.n_leds % field_len) / 2;
     for (int em = 0; em < rad_game_source.n_players; ++em)
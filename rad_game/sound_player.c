@@ -12,6 +12,7 @@
 #endif
 
 #include "sound_player.h"
+#include "replay.h"
 
 struct SoundEffect
 {
@@ -69,6 +70,12 @@ static char* effect_files[SE_N_EFFECTS] =
 
 static void init_hw()
 {
+    if (Replay_get_mode() == RM_PLAY) //headless, the song positions come from the recording
+    {
+        period_size = 256;
+        is_hw_init = 1;
+        return;
+    }
     int err;
     snd_pcm_hw_params_t* hw_params;
 
@@ -225,8 +232,14 @@ enum ESoundEffects SoundPlayer_get_current_effect()
 
 static void start_playing(char* filename)
 {
-    if (is_playing == 1)
+    if (is_playing == 1 && fin)
         fclose(fin);
+    fin = NULL;
+    if (Replay_get_mode() == RM_PLAY)
+    {
+        is_playing = 1;
+        return;
+    }
     if (is_hw_init == 0)
         init_hw();
     //open input file
@@ -275,7 +288,7 @@ void SoundPlayer_init_for_effect()
 //! Parameter \p new_effect is effectively optional, if present it will immediately start playing
 //! @param  new_effect Enum of the effect to player or SE_N_EFFECTS when no new effect is required
 //! @return -1 when nothing is playing, -2 when only effect is playing, elapsed time in track in us 
-long SoundPlayer_play(enum ESoundEffects new_effect)
+static long play(enum ESoundEffects new_effect)
 {
     if (is_playing == 0 && current_effect == SE_N_EFFECTS && new_effect == SE_N_EFFECTS)
     {
@@ -411,19 +424,33 @@ long SoundPlayer_play(enum ESoundEffects new_effect)
 	return time_running_us;
 }
 
+long SoundPlayer_play(enum ESoundEffects new_effect)
+{
+    if (Replay_get_mode() == RM_PLAY)
+        return Replay_read_sound();
+    long position = play(new_effect);
+    if (Replay_get_mode() == RM_RECORD)
+        Replay_write_sound(position);
+    return position;
+}
+
 void SoundPlayer_stop()
 {
     printf("Stopping player\n");
     if (!is_playing)
         return;
-    if (is_playing == 1)
+    if (is_playing == 1 && fin)
     {
         fclose(fin);
+        fin = NULL;
     }
     current_effect = SE_N_EFFECTS;
 #ifdef __linux__
-     snd_pcm_drain(pcm_handle);
-     snd_pcm_close(pcm_handle);
+    if (Replay_get_mode() != RM_PLAY)
+    {
+        snd_pcm_drain(pcm_handle);
+        snd_pcm_close(pcm_handle);
+    }
 #endif
     is_hw_init = 0;
     is_playing = 0;